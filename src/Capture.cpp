@@ -0,0 +1,112 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "Capture.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace Capture {
+
+// little endian encoding
+static void put32(unsigned char *out, uint32_t value) {
+    for(int i = 0; i < 4; ++i) {out[i] = (value >> (8 * i)) & 0xFF;}
+}
+
+static void put64(unsigned char *out, uint64_t value) {
+    for(int i = 0; i < 8; ++i) {out[i] = (value >> (8 * i)) & 0xFF;}
+}
+
+static uint32_t get32(const unsigned char *in) {
+    uint32_t value = 0;
+    for(int i = 0; i < 4; ++i) {value |= (uint32_t)in[i] << (8 * i);}
+    return value;
+}
+
+static uint64_t get64(const unsigned char *in) {
+    uint64_t value = 0;
+    for(int i = 0; i < 8; ++i) {value |= (uint64_t)in[i] << (8 * i);}
+    return value;
+}
+
+// Writer
+
+Writer::~Writer() {
+    close();
+}
+
+bool Writer::open(const std::string &path) {
+    if(!file.open(path)) {return false;}
+    std::chrono::nanoseconds start =
+        std::chrono::system_clock::now().time_since_epoch();
+    unsigned char header[HEADER_SIZE];
+    std::memcpy(header, MAGIC, 4);
+    put32(header + 4, VERSION);
+    put64(header + 8, start.count());
+    file.write(header, HEADER_SIZE);
+    records = 0;
+    return true;
+}
+
+void Writer::close() {
+    if(!file.isOpen()) {return;}
+    file.close();
+    writes = file.writes;
+}
+
+void Writer::write(uint64_t nanos, const unsigned char *bytes, size_t size) {
+    if(!file.isOpen()) {return;}
+    unsigned char header[RECORD_HEADER_SIZE];
+    put32(header, size);
+    put64(header + 4, nanos);
+    file.write(header, RECORD_HEADER_SIZE);
+    file.write(bytes, size);
+    records++;
+}
+
+// Reader
+
+bool Reader::open(const unsigned char *data, size_t size) {
+    if(size < HEADER_SIZE || std::memcmp(data, MAGIC, 4) != 0) {
+        std::cout << "not a capture file" << std::endl;
+        return false;
+    }
+    uint32_t version = get32(data + 4);
+    if(version != VERSION) {
+        std::cout << "unsupported capture version " << version << std::endl;
+        return false;
+    }
+    this->data = data;
+    this->size = size;
+    startTime = get64(data + 8);
+    pos = HEADER_SIZE;
+    return true;
+}
+
+bool Reader::next(uint64_t &nanos, const unsigned char *&bytes, size_t &size) {
+    if(pos + RECORD_HEADER_SIZE > this->size) {return false;}
+    size_t length = get32(data + pos);
+    if(pos + RECORD_HEADER_SIZE + length > this->size) {return false;}
+    nanos = get64(data + pos + 4);
+    bytes = data + pos + RECORD_HEADER_SIZE;
+    size = length;
+    pos += RECORD_HEADER_SIZE + length;
+    return true;
+}
+
+} // namespace
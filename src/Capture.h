@@ -0,0 +1,98 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FileWriter.h"
+
+// binary MIDI capture format
+//
+// a capture is a fixed 16 byte header followed by one record per
+// message, all values are little endian:
+//
+//   header: "MTCP" magic, uint32 version (1), uint64 start time in
+//           nanoseconds since the Unix epoch, for reference only
+//   record: uint32 message size, uint64 time in nanoseconds since the
+//           capture started, message bytes
+//
+// records can be read in place from a memory mapped file
+namespace Capture {
+
+const char MAGIC[4] = {'M', 'T', 'C', 'P'};
+const uint32_t VERSION = 1;
+const size_t HEADER_SIZE = 16;
+const size_t RECORD_HEADER_SIZE = 12;
+
+// buffered capture file writer
+class Writer {
+
+    public:
+
+        Writer() {}
+        virtual ~Writer();
+
+        // create or truncate a capture file & write the header, prints an
+        // error & returns false if it could not be opened
+        bool open(const std::string &path);
+
+        // write buffered records & close the file
+        void close();
+
+        // append a record, the file is only written once the buffer is full
+        void write(uint64_t nanos, const unsigned char *bytes, size_t size);
+
+        bool isOpen() const {return file.isOpen();}
+
+        // stats
+        unsigned long records = 0;
+        unsigned long writes = 0; // write() calls, set on close
+
+    protected:
+
+        FileWriter file;
+};
+
+// capture record iterator over a block of memory, ie. a mapped file
+class Reader {
+
+    public:
+
+        // check the header, prints an error & returns false if the data is
+        // not a capture
+        bool open(const unsigned char *data, size_t size);
+
+        // read the next record, returns false at the end or if the last
+        // record is truncated
+        bool next(uint64_t &nanos, const unsigned char *&bytes, size_t &size);
+
+        // rewind to the first record
+        void rewind() {pos = HEADER_SIZE;}
+
+        uint64_t startTime = 0; // nanoseconds since the Unix epoch
+
+    protected:
+
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        size_t pos = 0;
+};
+
+} // namespace
@@ -0,0 +1,145 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "FileWriter.h"
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+FileWriter::FileWriter(size_t bufferSize) : bufferSize(bufferSize) {
+    buffer.reserve(bufferSize);
+}
+
+FileWriter::~FileWriter() {
+    close();
+}
+
+bool FileWriter::open(const std::string &path) {
+    close();
+#ifdef _WIN32
+    fp = std::fopen(path.c_str(), "wb");
+    if(!fp) {
+#else
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+#endif
+        std::cout << "could not open " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return false;
+    }
+    this->path = path;
+    ownsFile = true;
+    failed = false;
+    writes = 0;
+    return true;
+}
+
+void FileWriter::openStdout() {
+    close();
+#ifdef _WIN32
+    fp = stdout;
+#else
+    fd = STDOUT_FILENO;
+#endif
+    path = "stdout";
+    ownsFile = false;
+    failed = false;
+    writes = 0;
+}
+
+void FileWriter::close() {
+    if(!isOpen()) {return;}
+    flush();
+#ifdef _WIN32
+    if(ownsFile) {std::fclose(fp);}
+    fp = nullptr;
+#else
+    if(ownsFile) {::close(fd);}
+    fd = -1;
+#endif
+}
+
+void FileWriter::write(const void *bytes, size_t size) {
+    if(!isOpen()) {return;}
+    if(buffer.size() + size > bufferSize) {
+        flush();
+    }
+    if(size >= bufferSize) {
+        writeAll((const unsigned char *)bytes, size);
+        return;
+    }
+    const unsigned char *data = (const unsigned char *)bytes;
+    buffer.insert(buffer.end(), data, data + size);
+}
+
+void FileWriter::flush() {
+    if(buffer.empty()) {return;}
+    writeAll(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+bool FileWriter::writeAt(uint64_t offset, const void *bytes, size_t size) {
+    if(!isOpen()) {return false;}
+    flush();
+#ifdef _WIN32
+    // seek back to the end afterwards so later writes append
+    bool ok = (std::fseek(fp, (long)offset, SEEK_SET) == 0 &&
+               std::fwrite(bytes, 1, size, fp) == size);
+    std::fseek(fp, 0, SEEK_END);
+    if(!ok) {
+#else
+    if(pwrite(fd, bytes, size, offset) != (ssize_t)size) {
+#endif
+        writeError();
+        return false;
+    }
+    return true;
+}
+
+void FileWriter::writeAll(const unsigned char *bytes, size_t size) {
+#ifdef _WIN32
+    if(std::fwrite(bytes, 1, size, fp) != size) {
+        writeError();
+    }
+    std::fflush(fp);
+    writes++;
+#else
+    while(size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if(written < 0) {
+            if(errno == EINTR) {continue;}
+            writeError();
+            break;
+        }
+        bytes += written;
+        size -= written;
+        writes++;
+    }
+#endif
+}
+
+void FileWriter::writeError() {
+    if(failed) {return;}
+    failed = true;
+    std::cout << "could not write " << path << ": "
+              << std::strerror(errno) << std::endl;
+}
@@ -0,0 +1,87 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// buffered binary file writer
+//
+// bytes are collected in a buffer which is written to the file in large
+// blocks once it fills up or when flushed, blocks at least as large as
+// the buffer are written straight through without copying
+//
+// uses POSIX file descriptors or stdio streams on Windows
+class FileWriter {
+
+    public:
+
+        FileWriter(size_t bufferSize=65536);
+        virtual ~FileWriter();
+
+        // create or truncate a file, prints an error & returns false if it
+        // could not be opened
+        bool open(const std::string &path);
+
+        // write to stdout, which is left open on close
+        void openStdout();
+
+        // write buffered bytes & close the file
+        void close();
+
+#ifdef _WIN32
+        bool isOpen() const {return fp != nullptr;}
+#else
+        bool isOpen() const {return fd >= 0;}
+#endif
+
+        // append bytes, the file is only written once the buffer is full
+        void write(const void *bytes, size_t size);
+
+        // write buffered bytes to the file
+        void flush();
+
+        // flush & overwrite bytes at an offset from the start of the file,
+        // ie. to patch a header, returns false on error
+        bool writeAt(uint64_t offset, const void *bytes, size_t size);
+
+        // stats
+        unsigned long writes = 0; // write() calls
+
+    protected:
+
+        // write a block, write() may return early, prints the first error
+        void writeAll(const unsigned char *bytes, size_t size);
+
+        // print a write error once
+        void writeError();
+
+#ifdef _WIN32
+        FILE *fp = nullptr;
+#else
+        int fd = -1;
+#endif
+        bool ownsFile = false;
+        bool failed = false;
+        std::string path;
+        size_t bufferSize;
+        std::vector<unsigned char> buffer;
+};
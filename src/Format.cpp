@@ -0,0 +1,83 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "Format.h"
+#include <cstdio>
+
+// build byte rendering table
+static ByteTable makeByteTable(bool hex, bool name) {
+    ByteTable table(256);
+    for(int byte = 0; byte < 256; ++byte) {
+        ByteText &entry = table[byte];
+        int size;
+        if(name && (byte & 0x80)) {
+            size = snprintf(entry.text, sizeof(entry.text), "%s ",
+                            statusByteName(byte));
+        }
+        else {
+            size = snprintf(entry.text, sizeof(entry.text),
+                            (hex ? "%X " : "%d "), byte);
+        }
+        entry.size = size;
+    }
+    return table;
+}
+
+const ByteTable& byteTable(bool hex, bool name) {
+    static const ByteTable tables[4] = {
+        makeByteTable(false, false), makeByteTable(true, false),
+        makeByteTable(false, true),  makeByteTable(true, true)
+    };
+    return tables[(hex ? 1 : 0) + (name ? 2 : 0)];
+}
+
+void formatMessage(const ByteTable &table,
+                   const std::vector<unsigned char> &message,
+                   std::string &buffer) {
+    if(message.size() < 1) {return;}
+    for(unsigned char byte : message) {
+        const ByteText &entry = table[byte];
+        buffer.append(entry.text, entry.size);
+    }
+    buffer += '\n';
+}
+
+const char* statusByteName(unsigned char status) {
+    if(status < MIDI_SYSEX) status = status & 0xF0;
+    switch(status) {
+        case MIDI_NOTEOFF:        return "NOTEOFF";
+        case MIDI_NOTEON:         return "NOTEON";
+        case MIDI_POLYAFTERTOUCH: return "POLYAFTERTOUCH";
+        case MIDI_CONTROLCHANGE:  return "CONTROLCHANGE";
+        case MIDI_PROGRAMCHANGE:  return "PROGRAMCHANGE";
+        case MIDI_AFTERTOUCH:     return "AFTERTOUCH";
+        case MIDI_PITCHBEND:      return "PITCHBEND";
+        case MIDI_SYSEX:          return "SYSEX";
+        case MIDI_TIMECODE:       return "TIMECODE";
+        case MIDI_SONGPOS:        return "SONGPOS";
+        case MIDI_SONGSELECT:     return "SONGSELECT";
+        case MIDI_TUNEREQUEST:    return "TUNEREQUEST";
+        case MIDI_SYSEXEND:       return "SYSEXEND";
+        case MIDI_CLOCK:          return "CLOCK";
+        case MIDI_START:          return "START";
+        case MIDI_CONTINUE:       return "CONTINUE";
+        case MIDI_STOP:           return "STOP";
+        case MIDI_ACTIVESENSING:  return "ACTIVESENSE";
+        case MIDI_SYSTEMRESET:    return "SYSTEMRESET";
+        default:                  return "UNKNOWN";
+    }
+}
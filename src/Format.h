@@ -0,0 +1,71 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <string>
+#include <vector>
+
+// channel voice message     dec value, # data bytes
+#define MIDI_NOTEOFF        0x80 // 128, 2
+#define MIDI_NOTEON         0x90 // 144, 2
+#define MIDI_POLYAFTERTOUCH 0xA0 // 160, 2, aka key pressure
+#define MIDI_CONTROLCHANGE  0xB0 // 176, 2
+#define MIDI_PROGRAMCHANGE  0xC0 // 192, 1
+#define MIDI_AFTERTOUCH     0xD0 // 208, 1, aka channel pressure
+#define MIDI_PITCHBEND      0xE0 // 224, 2
+
+// system common message
+#define MIDI_SYSEX          0xF0 // 240, variable, until MIDI_SYSEXEND
+#define MIDI_TIMECODE       0xF1 // 241, 1
+#define MIDI_SONGPOS        0xF2 // 242, 2
+#define MIDI_SONGSELECT     0xF3 // 243, 1
+//      MIDI_RESERVED1      0xF4 // 244, ?
+//      MIDI_RESERVED2      0xF5 // 245, ?
+#define MIDI_TUNEREQUEST    0xF6 // 246, 0
+#define MIDI_SYSEXEND       0xF7 // 247, 0
+
+// realtime message
+#define MIDI_CLOCK          0xF8 // 248, 0
+//      MIDI_RESERVED3      0xF9 // 249, ?
+#define MIDI_START          0xFA // 250, 0
+#define MIDI_CONTINUE       0xFB // 251, 0
+#define MIDI_STOP           0xFC // 252, 0
+//      MIDI_RESERVED4      0xFD // 253, 0
+#define MIDI_ACTIVESENSING  0xFE // 254, 0
+#define MIDI_SYSTEMRESET    0xFF // 255, 0
+
+// precomputed console rendering of a single byte value including the
+// trailing space, ie. "90 ", "144 ", or "NOTEON "
+struct ByteText {
+    char text[16];
+    unsigned char size;
+};
+typedef std::vector<ByteText> ByteTable;
+
+// get the 256 entry byte rendering table for the given print options,
+// set hex to true to print byte values in hexidecimal
+// set name to true to print the name of the status bytes
+const ByteTable& byteTable(bool hex, bool name);
+
+// append midi byte message as a line of text to a buffer
+void formatMessage(const ByteTable &table,
+                   const std::vector<unsigned char> &message,
+                   std::string &buffer);
+
+// get string name for status byte
+const char* statusByteName(unsigned char status);
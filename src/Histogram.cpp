@@ -0,0 +1,157 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "Histogram.h"
+
+#include <cmath>
+
+// index of the most significant bit set, value must be non-zero
+static int msb(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while(value >>= 1) {bit++;}
+    return bit;
+#endif
+}
+
+Histogram::Histogram() {
+    clear();
+}
+
+void Histogram::record(int64_t nanos) {
+    if(nanos < 0) {nanos = 0;}
+    counts[bucketIndex(nanos)]++;
+    if(total == 0 || nanos < minimum) {minimum = nanos;}
+    if(total == 0 || nanos > maximum) {maximum = nanos;}
+    total++;
+    sum += nanos;
+    squareSum += (double)nanos * nanos;
+}
+
+void Histogram::merge(const Histogram &other) {
+    if(other.total == 0) {return;}
+    for(int i = 0; i < BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    if(total == 0 || other.minimum < minimum) {minimum = other.minimum;}
+    if(total == 0 || other.maximum > maximum) {maximum = other.maximum;}
+    total += other.total;
+    sum += other.sum;
+    squareSum += other.squareSum;
+}
+
+void Histogram::clear() {
+    for(int i = 0; i < BUCKETS; ++i) {
+        counts[i] = 0;
+    }
+    total = 0;
+    minimum = 0;
+    maximum = 0;
+    sum = 0;
+    squareSum = 0;
+}
+
+double Histogram::mean() const {
+    if(total == 0) {return 0;}
+    return sum / total;
+}
+
+double Histogram::dev() const {
+    if(total == 0) {return 0;}
+    double avg = mean();
+    double variance = squareSum / total - avg * avg;
+    return (variance > 0 ? std::sqrt(variance) : 0);
+}
+
+int64_t Histogram::percentile(double p) const {
+    if(total == 0) {return 0;}
+
+    // nearest rank
+    uint64_t rank = (uint64_t)std::ceil(p / 100.0 * total);
+    if(rank < 1) {rank = 1;}
+    if(rank > total) {rank = total;}
+
+    // find the bucket & use its midpoint, clamped to the recorded range
+    uint64_t seen = 0;
+    for(int i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if(seen >= rank) {
+            int64_t value = (bucketLower(i) + bucketUpper(i) - 1) / 2;
+            if(value < minimum) {value = minimum;}
+            if(value > maximum) {value = maximum;}
+            return value;
+        }
+    }
+    return maximum;
+}
+
+void Histogram::writeCsv(std::ostream &out, const std::string &name, bool header) const {
+    if(header) {out << "name,lower,upper,count\n";}
+    for(int i = 0; i < BUCKETS; ++i) {
+        if(counts[i] == 0) {continue;}
+        out << name << "," << bucketLower(i) << "," << bucketUpper(i)
+            << "," << counts[i] << "\n";
+    }
+}
+
+void Histogram::writeJson(std::ostream &out) const {
+    static const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    out << "{\"count\": " << total
+        << ", \"min\": " << min()
+        << ", \"max\": " << max()
+        << ", \"mean\": " << mean()
+        << ", \"dev\": " << dev()
+        << ", \"percentiles\": {";
+    for(unsigned int i = 0; i < sizeof(percentiles) / sizeof(double); ++i) {
+        if(i > 0) {out << ", ";}
+        out << "\"" << percentiles[i] << "\": " << percentile(percentiles[i]);
+    }
+    out << "}, \"buckets\": [";
+    bool first = true;
+    for(int i = 0; i < BUCKETS; ++i) {
+        if(counts[i] == 0) {continue;}
+        if(!first) {out << ", ";}
+        out << "[" << bucketLower(i) << ", " << bucketUpper(i)
+            << ", " << counts[i] << "]";
+        first = false;
+    }
+    out << "]}";
+}
+
+int Histogram::bucketIndex(uint64_t nanos) {
+    if(nanos < (uint64_t)SUB_BUCKETS) {return (int)nanos;}
+    int bit = msb(nanos);
+    if(bit >= MAX_BITS) {return BUCKETS - 1;}
+    int shift = bit - SUB_BITS;
+    int sub = (int)(nanos >> shift) - SUB_BUCKETS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::bucketLower(int index) {
+    if(index < SUB_BUCKETS) {return index;}
+    int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    int sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    return (uint64_t)(SUB_BUCKETS + sub) << shift;
+}
+
+uint64_t Histogram::bucketUpper(int index) {
+    if(index < SUB_BUCKETS) {return index + 1;}
+    int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    return bucketLower(index) + ((uint64_t)1 << shift);
+}
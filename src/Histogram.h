@@ -0,0 +1,87 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// fixed memory log-linear latency histogram, HDR style
+//
+// values are nanoseconds: values below 64 get exact buckets, larger
+// values are split into powers of two with 64 linear sub-buckets each,
+// so recorded values are accurate to within ~1.6%, up to 2^48 ns (~78
+// hours), anything larger goes into the last bucket
+//
+// recording does not allocate, use one histogram per thread & merge()
+// them afterwards instead of sharing one between threads
+class Histogram {
+
+    public:
+
+        // bucket layout
+        static const int SUB_BITS = 6;
+        static const int SUB_BUCKETS = 1 << SUB_BITS;
+        static const int MAX_BITS = 48;
+        static const int BUCKETS = SUB_BUCKETS + (MAX_BITS - SUB_BITS) * SUB_BUCKETS;
+
+        Histogram();
+
+        // record a value in nanoseconds, negative values are recorded as 0
+        void record(int64_t nanos);
+
+        // record a value in seconds
+        void recordSeconds(double seconds) {record((int64_t)(seconds * 1000000000.0));}
+
+        // add the counts of another histogram
+        void merge(const Histogram &other);
+
+        // clear all counts
+        void clear();
+
+        // stats in nanoseconds
+        uint64_t count() const {return total;}
+        int64_t min() const {return total > 0 ? minimum : 0;}
+        int64_t max() const {return total > 0 ? maximum : 0;}
+        double mean() const;
+        double dev() const; // standard deviation
+
+        // value at percentile p 0-100, ie. 99.9, within the bucket precision
+        int64_t percentile(double p) const;
+
+        // write non-empty buckets as CSV lines: name,lower,upper,count
+        // with an optional header line
+        void writeCsv(std::ostream &out, const std::string &name, bool header=true) const;
+
+        // write summary stats, percentiles & non-empty buckets as a JSON object
+        void writeJson(std::ostream &out) const;
+
+        // bucket index for a value & value range for a bucket index
+        static int bucketIndex(uint64_t nanos);
+        static uint64_t bucketLower(int index);
+        static uint64_t bucketUpper(int index); // exclusive
+
+    protected:
+
+        uint64_t counts[BUCKETS];
+        uint64_t total;
+        int64_t minimum;
+        int64_t maximum;
+        double sum;
+        double squareSum;
+};
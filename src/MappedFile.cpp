@@ -0,0 +1,111 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "MappedFile.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#ifdef _WIN32
+    #include <fstream>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+// no mmap, read the whole file into memory instead
+bool MappedFile::open(const std::string &path) {
+    close();
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!file.is_open()) {
+        std::cout << "could not open " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::streamoff size = file.tellg();
+    if(size > 0) {
+        unsigned char *data = new unsigned char[size];
+        file.seekg(0);
+        if(!file.read((char *)data, size)) {
+            std::cout << "could not read " << path << std::endl;
+            delete [] data;
+            return false;
+        }
+        bytes = data;
+        length = size;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if(bytes) {
+        delete [] bytes;
+        bytes = nullptr;
+        length = 0;
+    }
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cout << "could not open " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) < 0) {
+        std::cout << "could not stat " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    if(info.st_size > 0) {
+        void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED) {
+            std::cout << "could not map " << path << ": "
+                      << std::strerror(errno) << std::endl;
+            ::close(fd);
+            return false;
+        }
+        madvise(map, info.st_size, MADV_SEQUENTIAL);
+        bytes = (const unsigned char *)map;
+        length = info.st_size;
+    }
+    ::close(fd); // the mapping stays valid
+    return true;
+}
+
+void MappedFile::close() {
+    if(bytes) {
+        munmap((void *)bytes, length);
+        bytes = nullptr;
+        length = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,50 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapped file
+//
+// the file contents are accessed in place, without reading them into
+// a buffer first, and the mapping is released on close or destruction,
+// on Windows the file is read into memory instead
+class MappedFile {
+
+    public:
+
+        MappedFile() {}
+        virtual ~MappedFile();
+
+        // map a file, returns false & prints an error if it could not be
+        // opened or mapped, an empty file maps to size 0 & no data
+        bool open(const std::string &path);
+
+        // unmap the file
+        void close();
+
+        // mapped contents
+        const unsigned char* data() const {return bytes;}
+        size_t size() const {return length;}
+
+    protected:
+
+        const unsigned char *bytes = nullptr;
+        size_t length = 0;
+};
@@ -0,0 +1,350 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "MidiFile.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// offset of the MTrk length in a type 0 file
+#define MIDIFILE_TRACK_LENGTH_OFFSET 18
+
+// big endian encoding
+static void put16(std::vector<unsigned char> &out, uint16_t value) {
+    out.push_back(value >> 8);
+    out.push_back(value & 0xFF);
+}
+
+static void put32(std::vector<unsigned char> &out, uint32_t value) {
+    for(int i = 3; i >= 0; --i) {out.push_back((value >> (8 * i)) & 0xFF);}
+}
+
+MidiFileWriter::~MidiFileWriter() {
+    close();
+}
+
+bool MidiFileWriter::open(const std::string &path, unsigned int ppq, unsigned int tempo) {
+    close();
+    if(!file.open(path)) {return false;}
+    ticksPerSecond = ppq * 1000000.0 / tempo;
+    lastTick = 0;
+    trackSize = 0;
+    events = 0;
+    skipped = 0;
+    event.clear();
+
+    // header chunk: format 0, 1 track, ppq division
+    event.insert(event.end(), {'M', 'T', 'h', 'd'});
+    put32(event, 6);
+    put16(event, 0);
+    put16(event, 1);
+    put16(event, ppq & 0x7FFF);
+
+    // track chunk with the length patched on close
+    event.insert(event.end(), {'M', 'T', 'r', 'k'});
+    put32(event, 0);
+    size_t trackStart = event.size();
+
+    // tempo meta event
+    event.insert(event.end(), {0x00, 0xFF, 0x51, 0x03});
+    event.push_back((tempo >> 16) & 0xFF);
+    event.push_back((tempo >> 8) & 0xFF);
+    event.push_back(tempo & 0xFF);
+    trackSize += event.size() - trackStart;
+    file.write(event.data(), event.size());
+    return true;
+}
+
+void MidiFileWriter::close() {
+    if(!file.isOpen()) {return;}
+
+    // end of track meta event
+    const unsigned char end[] = {0x00, 0xFF, 0x2F, 0x00};
+    file.write(end, sizeof(end));
+    trackSize += sizeof(end);
+
+    // patch the track length
+    std::vector<unsigned char> length;
+    put32(length, trackSize);
+    file.writeAt(MIDIFILE_TRACK_LENGTH_OFFSET, length.data(), length.size());
+    file.close();
+}
+
+void MidiFileWriter::write(double seconds, const unsigned char *bytes, size_t size) {
+    if(!file.isOpen() || size == 0) {return;}
+    unsigned char status = bytes[0];
+
+    // ignore data without a status & incomplete sysex
+    if(status < 0x80 || (status == 0xF0 && bytes[size - 1] != 0xF7)) {
+        skipped++;
+        return;
+    }
+
+    // quantize the absolute time so rounding does not add up
+    uint64_t tick = (uint64_t)std::llround(seconds * ticksPerSecond);
+    if(tick < lastTick) {tick = lastTick;}
+    uint64_t delta = tick - lastTick;
+    if(delta > 0x0FFFFFFF) {delta = 0x0FFFFFFF;} // largest variable length value
+    lastTick += delta;
+
+    // the message bytes, ie. a large sysex, are written without copying
+    // them into the event buffer
+    event.clear();
+    putVarLen(delta);
+    const unsigned char *data = bytes;
+    if(status == 0xF0) {
+        // sysex: F0, length of the rest, rest including F7
+        event.push_back(0xF0);
+        putVarLen(size - 1);
+        data++;
+        size--;
+    }
+    else if(status >= 0xF0) {
+        // anything else as is with an F7 escape
+        event.push_back(0xF7);
+        putVarLen(size);
+    }
+    file.write(event.data(), event.size());
+    file.write(data, size);
+    trackSize += event.size() + size;
+    events++;
+}
+
+void MidiFileWriter::putVarLen(uint32_t value) {
+    unsigned char bytes[5];
+    int count = 0;
+    bytes[count++] = value & 0x7F;
+    while(value >>= 7) {
+        bytes[count++] = (value & 0x7F) | 0x80;
+    }
+    while(count > 0) {
+        event.push_back(bytes[--count]);
+    }
+}
+
+// big endian decoding
+static uint32_t get16(const unsigned char *p) {
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+bool MidiFileReader::open(const unsigned char *data, size_t size) {
+    tracks.clear();
+    if(size < 14 || std::memcmp(data, "MThd", 4) != 0 || get32(data + 4) < 6) {
+        std::cout << "not a midi file" << std::endl;
+        return false;
+    }
+    format = get16(data + 8);
+    unsigned int count = get16(data + 10);
+    division = get16(data + 12);
+    if(format > 1) {
+        std::cout << "midi file type " << format << " is not supported" << std::endl;
+        return false;
+    }
+    if(division == 0) {
+        std::cout << "midi file division is 0" << std::endl;
+        return false;
+    }
+
+    // find the track chunks, skipping unknown chunks
+    const unsigned char *end = data + size;
+    const unsigned char *chunk = data + 8 + get32(data + 4);
+    while(chunk + 8 <= end && tracks.size() < count) {
+        uint32_t length = get32(chunk + 4);
+        const unsigned char *begin = chunk + 8;
+        if(length > (size_t)(end - begin)) {
+            std::cout << "midi file truncated" << std::endl;
+            length = end - begin;
+        }
+        if(std::memcmp(chunk, "MTrk", 4) == 0) {
+            tracks.push_back({begin, begin, begin + length, 0, 0, false});
+        }
+        chunk = begin + length;
+    }
+    if(tracks.size() < count) {
+        std::cout << "midi file has " << tracks.size() << " of "
+                  << count << " tracks" << std::endl;
+    }
+    rewind();
+    return true;
+}
+
+void MidiFileReader::rewind() {
+    tempoChanges = 0;
+    errors = 0;
+    lastSeconds = 0;
+    lastTick = 0;
+    if(division & 0x8000) {
+        // SMPTE: negative frames per second & ticks per frame
+        int fps = -(int8_t)(division >> 8);
+        smpte = true;
+        secondsPerTick = 1.0 / (fps * (division & 0xFF));
+    }
+    else {
+        // 120 bpm until the first tempo change
+        smpte = false;
+        secondsPerTick = 500000 / (division * 1000000.0);
+    }
+    for(auto &track : tracks) {
+        track.pos = track.begin;
+        track.tick = 0;
+        track.runningStatus = 0;
+        track.done = false;
+        readDelta(track);
+    }
+}
+
+bool MidiFileReader::next(double &seconds, const unsigned char *&bytes, size_t &size) {
+    while(true) {
+
+        // earliest next event, the first track wins ties
+        Track *track = nullptr;
+        for(auto &t : tracks) {
+            if(!t.done && (!track || t.tick < track->tick)) {track = &t;}
+        }
+        if(!track) {return false;}
+
+        // advance the tempo map
+        lastSeconds += (track->tick - lastTick) * secondsPerTick;
+        lastTick = track->tick;
+
+        // status
+        unsigned char status = *track->pos;
+        if(status < 0x80) {
+            status = track->runningStatus;
+            if(status == 0) {
+                trackError(*track, "data without status");
+                continue;
+            }
+        }
+        else {
+            track->pos++;
+        }
+
+        // sysex & meta events cancel running status
+        if(status >= 0xF0) {track->runningStatus = 0;}
+
+        uint32_t length;
+        if(status < 0xF0) {
+            // channel message
+            track->runningStatus = status;
+            length = (status & 0xE0) == 0xC0 ? 1 : 2;
+            if(length > (size_t)(track->end - track->pos)) {
+                trackError(*track, "truncated event");
+                continue;
+            }
+            message.assign(1, status);
+            message.insert(message.end(), track->pos, track->pos + length);
+            track->pos += length;
+            bytes = message.data();
+            size = message.size();
+        }
+        else if(status == 0xF0 || status == 0xF7) {
+            // sysex or escape
+            if(!getLength(*track, length)) {continue;}
+            if(status == 0xF0) {
+                message.assign(1, status);
+                message.insert(message.end(), track->pos, track->pos + length);
+                bytes = message.data();
+                size = message.size();
+            }
+            else {
+                bytes = track->pos;
+                size = length;
+            }
+            track->pos += length;
+            if(size == 0) {
+                readDelta(*track);
+                continue;
+            }
+        }
+        else if(status == 0xFF) {
+            // meta event
+            if(track->pos == track->end) {
+                trackError(*track, "truncated meta event");
+                continue;
+            }
+            unsigned char type = *track->pos++;
+            if(!getLength(*track, length)) {continue;}
+            if(type == 0x2F) {
+                track->done = true;
+                continue;
+            }
+            if(type == 0x51 && length == 3 && !smpte) {
+                uint32_t tempo = (track->pos[0] << 16) | (track->pos[1] << 8) | track->pos[2];
+                secondsPerTick = tempo / (division * 1000000.0);
+                tempoChanges++;
+            }
+            track->pos += length;
+            readDelta(*track);
+            continue;
+        }
+        else {
+            trackError(*track, "invalid status");
+            continue;
+        }
+        seconds = lastSeconds;
+        readDelta(*track);
+        return true;
+    }
+}
+
+void MidiFileReader::readDelta(Track &track) {
+    if(track.pos >= track.end) {
+        track.done = true;
+        return;
+    }
+    uint32_t delta;
+    if(!getVarLen(track, delta)) {return;}
+    if(track.pos >= track.end) {
+        trackError(track, "truncated event");
+        return;
+    }
+    track.tick += delta;
+}
+
+bool MidiFileReader::getVarLen(Track &track, uint32_t &value) {
+    value = 0;
+    for(int i = 0; i < 4; ++i) {
+        if(track.pos >= track.end) {break;}
+        unsigned char byte = *track.pos++;
+        value = (value << 7) | (byte & 0x7F);
+        if(!(byte & 0x80)) {return true;}
+    }
+    trackError(track, "invalid variable length");
+    return false;
+}
+
+bool MidiFileReader::getLength(Track &track, uint32_t &length) {
+    if(!getVarLen(track, length)) {return false;}
+    if(length > (size_t)(track.end - track.pos)) {
+        trackError(track, "truncated event");
+        return false;
+    }
+    return true;
+}
+
+void MidiFileReader::trackError(Track &track, const char *what) {
+    std::cout << "midi file track " << (&track - tracks.data()) << ": "
+              << what << std::endl;
+    track.done = true;
+    errors++;
+}
@@ -0,0 +1,139 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FileWriter.h"
+
+// streaming Standard MIDI File type 0 writer
+//
+// events are written to a single track as they come in with buffered
+// writes, the track length in the MTrk chunk header is patched when the
+// file is closed so a long recording is never held in memory
+//
+// event times are in seconds and quantized to ticks at a fixed tempo,
+// sysex is written as an F0 event & system common and realtime messages
+// as F7 escape sequences
+class MidiFileWriter {
+
+    public:
+
+        MidiFileWriter() {}
+        virtual ~MidiFileWriter();
+
+        // create or truncate a file & write the header chunk, ppq is ticks
+        // per quarter note & tempo micros per quarter note, prints an
+        // error & returns false if it could not be opened
+        bool open(const std::string &path, unsigned int ppq=480,
+                  unsigned int tempo=500000);
+
+        // write end of track, patch the track length & close the file
+        void close();
+
+        // append a message at an absolute time in seconds from the start
+        void write(double seconds, const unsigned char *bytes, size_t size);
+
+        bool isOpen() const {return file.isOpen();}
+
+        // stats
+        unsigned long events = 0;
+        unsigned long skipped = 0; // messages which can't be stored
+
+    protected:
+
+        // append a variable length quantity to the event buffer
+        void putVarLen(uint32_t value);
+
+        FileWriter file;
+        std::vector<unsigned char> event; // encoded event to write
+        double ticksPerSecond = 0;
+        uint64_t lastTick = 0;
+        uint64_t trackSize = 0; // bytes written after the MTrk header
+};
+
+// streaming Standard MIDI File type 0 & 1 reader
+//
+// events are parsed in place from a block of memory, ie. a memory mapped
+// file, as they are read so playback can start right away, the tracks
+// are merged in tick order & ticks are converted to seconds through the
+// tempo map on the way since tempo changes are met in order as well
+//
+// meta events are not returned, running status is resolved & cancelled
+// by sysex & meta events, sysex is returned with its F0 status byte, F7
+// escapes are returned as is
+class MidiFileReader {
+
+    public:
+
+        // parse the header chunk & locate the track chunks, prints an error
+        // & returns false if the data is not a type 0 or 1 file
+        bool open(const unsigned char *data, size_t size);
+
+        // get the next event & its time in seconds from the start, the bytes
+        // are valid until the next call, returns false at the end
+        bool next(double &seconds, const unsigned char *&bytes, size_t &size);
+
+        // start over from the first event
+        void rewind();
+
+        // header info
+        unsigned int format = 0;
+        unsigned int division = 0; // ticks per quarter note or SMPTE
+
+        size_t getTrackCount() const {return tracks.size();}
+
+        // stats
+        unsigned long tempoChanges = 0;
+        unsigned long errors = 0;   // tracks cut short by malformed data
+
+    protected:
+
+        // per track parse state, tick is the time of the next event
+        struct Track {
+            const unsigned char *begin;
+            const unsigned char *pos;
+            const unsigned char *end;
+            uint64_t tick;
+            unsigned char runningStatus;
+            bool done;
+        };
+
+        // read the delta time of a track's next event or mark it done
+        void readDelta(Track &track);
+
+        // read a variable length quantity, returns false if out of bounds
+        bool getVarLen(Track &track, uint32_t &value);
+
+        // read an event length, returns false if it runs past the track end
+        bool getLength(Track &track, uint32_t &length);
+
+        // stop a track on malformed data
+        void trackError(Track &track, const char *what);
+
+        std::vector<Track> tracks;
+        std::vector<unsigned char> message; // resolved event bytes
+
+        // tempo map state
+        double secondsPerTick = 0;
+        double lastSeconds = 0;
+        uint64_t lastTick = 0;
+        bool smpte = false; // SMPTE division ignores tempo
+};
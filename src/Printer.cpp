@@ -0,0 +1,125 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "Printer.h"
+#include "SteadyClock.h"
+
+// flush early once this many bytes are buffered
+#define PRINTER_BUFFER_SIZE 65536
+
+Printer::Printer(Formatter formatter, unsigned int queueSize) :
+    formatter(formatter), flushInterval(10), running(false), idle(false), droppedCount(0),
+    out(0) {
+    queue.allocate(queueSize);
+    arrivals.reserve(queueSize);
+    buffer.reserve(PRINTER_BUFFER_SIZE * 2);
+    out.openStdout();
+}
+
+Printer::~Printer() {
+    stop();
+}
+
+void Printer::start(std::chrono::milliseconds flushInterval) {
+    if(running) {return;}
+    this->flushInterval = flushInterval;
+    running = true;
+    thread = std::thread(&Printer::process, this);
+}
+
+void Printer::stop() {
+    if(!running) {return;}
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle = false;
+    }
+    wake.notify_one();
+    thread.join();
+    dropped = droppedCount;
+    writes = out.writes;
+}
+
+bool Printer::print(const std::vector<unsigned char> &message, uint64_t arrival) {
+    if(!queue.push(message, 0, arrival)) {
+        droppedCount++;
+        return false;
+    }
+
+    // wake the formatter thread if it's waiting, pairs with the fence in
+    // waitForMessages() so either it sees the message or this sees idle
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(idle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle = false;
+        wake.notify_one();
+    }
+    return true;
+}
+
+void Printer::process() {
+    std::vector<unsigned char> message;
+    double stamp;
+    unsigned long long arrival;
+    bool stopping = false;
+    while(!stopping) {
+        // check before draining so nothing pushed before stop() is missed
+        stopping = !running;
+        wakeups++;
+        while(queue.pop(&message, &stamp, &arrival)) {
+            formatter(buffer, message);
+            arrivals.push_back(arrival);
+            if(buffer.size() >= PRINTER_BUFFER_SIZE) {
+                flush();
+            }
+        }
+        flush();
+        if(!stopping) {
+            waitForMessages();
+        }
+    }
+}
+
+void Printer::waitForMessages() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(queue.size() == 0) {
+        wake.wait(lock, [this] {return !idle;});
+    }
+    idle = false;
+
+    // let the batch fill
+    wake.wait_for(lock, flushInterval, [this] {return !running;});
+}
+
+void Printer::flush() {
+    if(arrivals.empty()) {return;}
+
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+
+    // update latency stats
+    uint64_t time = steadyNanos();
+    for(uint64_t arrival : arrivals) {
+        double latency = (time > arrival ? time - arrival : 0) / 1000000000.0;
+        latencySum += latency;
+        if(latency > latencyMax) {latencyMax = latency;}
+    }
+    printed += arrivals.size();
+    arrivals.clear();
+}
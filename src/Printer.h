@@ -0,0 +1,101 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileWriter.h"
+#include "RtMidi.h"
+
+// asynchronous console printer stage
+//
+// messages are handed off from a single producer thread, ie. the MIDI
+// input thread, through a lock-free queue to a formatter thread which
+// batches the formatted lines into large write() calls on stdout
+//
+// the formatter thread sleeps until a message is queued, then gives the
+// batch up to a flush interval to fill before writing it, so it doesn't
+// wake at all while the input is idle
+//
+// if the queue is full, messages are dropped & counted instead of
+// blocking the producer
+class Printer {
+
+    public:
+
+        // appends a single formatted message to the output buffer
+        typedef std::function<void(std::string &buffer,
+                                   const std::vector<unsigned char> &message)> Formatter;
+
+        Printer(Formatter formatter, unsigned int queueSize=4096);
+        virtual ~Printer();
+
+        // start the formatter thread, a batch waits at most flushInterval
+        // before it is written
+        void start(std::chrono::milliseconds flushInterval);
+
+        // print remaining messages & stop the formatter thread
+        void stop();
+
+        // queue a message for printing, arrival is its absolute time in
+        // steady clock nanos, ie. from RtMidiIn::getMessageTime(), returns
+        // false if it was dropped, only call from one thread at a time
+        bool print(const std::vector<unsigned char> &message, uint64_t arrival);
+
+        // stats, read after stop()
+        unsigned long printed = 0;  // messages printed
+        unsigned long dropped = 0;  // messages dropped due to a full queue
+        unsigned long wakeups = 0;  // formatter thread wakeups
+        unsigned long writes = 0;   // write() calls
+        double latencySum = 0;      // arrival to print latency in seconds
+        double latencyMax = 0;
+
+    protected:
+
+        // formatter thread loop
+        void process();
+
+        // sleep until a message is queued or stop() is called, then
+        // until the flush interval has passed
+        void waitForMessages();
+
+        // write buffered output to stdout & update latency stats
+        void flush();
+
+        Formatter formatter;
+        MidiInApi::MidiQueue queue;
+        std::chrono::milliseconds flushInterval;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<bool> idle; // formatter thread is waiting for messages
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::atomic<unsigned long> droppedCount;
+        FileWriter out; // stdout, unbuffered as lines are batched below
+
+        // formatter thread buffers
+        std::string buffer;
+        std::vector<uint64_t> arrivals; // arrival nanos of buffered messages
+};
@@ -37,6 +37,9 @@
 /**********************************************************************/
 
 #include "RtMidi.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <sstream>
 
 #if defined(__MACOSX_CORE__)
@@ -88,6 +91,7 @@ void RtMidi :: getCompiledApi( std::vector<RtMidi::Api> &apis ) throw()
 #if defined(__RTMIDI_DUMMY__)
   apis.push_back( RTMIDI_DUMMY );
 #endif
+  apis.push_back( RTMIDI_LOOPBACK );
 }
 
 //*********************************************************************//
@@ -120,6 +124,8 @@ void RtMidiIn :: openMidiApi( RtMidi::Api api, const std::string clientName, uns
   if ( api == RTMIDI_DUMMY )
     rtapi_ = new MidiInDummy( clientName, queueSizeLimit );
 #endif
+  if ( api == RTMIDI_LOOPBACK )
+    rtapi_ = new MidiInLoopback( clientName, queueSizeLimit );
 }
 
 RtMidiIn :: RtMidiIn( RtMidi::Api api, const std::string clientName, unsigned int queueSizeLimit )
@@ -139,7 +145,9 @@ RtMidiIn :: RtMidiIn( RtMidi::Api api, const std::string clientName, unsigned in
   // one with at least one port or we reach the end of the list.
   std::vector< RtMidi::Api > apis;
   getCompiledApi( apis );
+  // The loopback API is only used when asked for.
   for ( unsigned int i=0; i<apis.size(); i++ ) {
+    if ( apis[i] == RTMIDI_LOOPBACK ) continue;
     openMidiApi( apis[i], clientName, queueSizeLimit );
     if ( rtapi_->getPortCount() ) break;
   }
@@ -189,6 +197,8 @@ void RtMidiOut :: openMidiApi( RtMidi::Api api, const std::string clientName )
   if ( api == RTMIDI_DUMMY )
     rtapi_ = new MidiOutDummy( clientName );
 #endif
+  if ( api == RTMIDI_LOOPBACK )
+    rtapi_ = new MidiOutLoopback( clientName );
 }
 
 RtMidiOut :: RtMidiOut( RtMidi::Api api, const std::string clientName )
@@ -207,7 +217,9 @@ RtMidiOut :: RtMidiOut( RtMidi::Api api, const std::string clientName )
   // one with at least one port or we reach the end of the list.
   std::vector< RtMidi::Api > apis;
   getCompiledApi( apis );
+  // The loopback API is only used when asked for.
   for ( unsigned int i=0; i<apis.size(); i++ ) {
+    if ( apis[i] == RTMIDI_LOOPBACK ) continue;
     openMidiApi( apis[i], clientName );
     if ( rtapi_->getPortCount() ) break;
   }
@@ -231,7 +243,7 @@ RtMidiOut :: ~RtMidiOut() throw()
 //*********************************************************************//
 
 MidiApi :: MidiApi( void )
-  : apiData_( 0 ), connected_( false ), errorCallback_(0), errorCallbackUserData_(0)
+  : apiData_( 0 ), connected_( false ), errorCallback_(0), firstErrorOccurred_(false), errorCallbackUserData_(0)
 {
 }
 
@@ -260,7 +272,7 @@ void MidiApi :: error( RtMidiError::Type type, std::string errorString )
     return;
   }
 
-  if ( type == RtMidiError::WARNING ) {
+  if ( type == RtMidiError::WARNING || type == RtMidiError::BUFFER_FULL ) {
     std::cerr << '\n' << errorString << "\n\n";
   }
   else if ( type == RtMidiError::DEBUG_WARNING ) {
@@ -278,19 +290,22 @@ void MidiApi :: error( RtMidiError::Type type, std::string errorString )
 //  Common MidiInApi Definitions
 //*********************************************************************//
 
+// The time base for absolute input time stamps: nanoseconds on the
+// steady clock, which is CLOCK_MONOTONIC on Linux.
+static unsigned long long monotonicNanos( void )
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
 MidiInApi :: MidiInApi( unsigned int queueSizeLimit )
   : MidiApi()
 {
-  // Allocate the MIDI queue.
-  inputData_.queue.ringSize = queueSizeLimit;
-  if ( inputData_.queue.ringSize > 0 )
-    inputData_.queue.ring = new MidiMessage[ inputData_.queue.ringSize ];
+  // Allocate the MIDI queue, it is freed with inputData_.
+  if ( queueSizeLimit > 0 ) inputData_.queue.allocate( queueSizeLimit );
 }
 
 MidiInApi :: ~MidiInApi( void )
 {
-  // Delete the MIDI queue.
-  if ( inputData_.queue.ringSize > 0 ) delete [] inputData_.queue.ring;
 }
 
 void MidiInApi :: setCallback( RtMidiIn::RtMidiCallback callback, void *userData )
@@ -333,6 +348,11 @@ void MidiInApi :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense )
   if ( midiSense ) inputData_.ignoreFlags |= 0x04;
 }
 
+void MidiInApi :: setSysexChunking( bool enable )
+{
+  inputData_.sysexChunking = enable;
+}
+
 double MidiInApi :: getMessage( std::vector<unsigned char> *message )
 {
   message->clear();
@@ -343,18 +363,170 @@ double MidiInApi :: getMessage( std::vector<unsigned char> *message )
     return 0.0;
   }
 
-  if ( inputData_.queue.size == 0 ) return 0.0;
+  double deltaTime = 0.0;
+  inputData_.queue.pop( message, &deltaTime, &inputData_.messageTime );
+  return deltaTime;
+}
+
+unsigned int MidiInApi :: getMessages( std::vector<unsigned char> *messages, double *deltaTimes, unsigned int count,
+                                       unsigned long long *absoluteTimes )
+{
+  if ( inputData_.usingCallback ) {
+    errorString_ = "RtMidiIn::getMessages: a user callback is currently set for this port.";
+    error( RtMidiError::WARNING, errorString_ );
+    return 0;
+  }
+
+  // Pop until the queue is empty or the caller's storage is full.
+  unsigned int n = 0;
+  while ( n < count && inputData_.queue.pop( &messages[n], &deltaTimes[n], &inputData_.messageTime ) ) {
+    if ( absoluteTimes ) absoluteTimes[n] = inputData_.messageTime;
+    n++;
+  }
+  return n;
+}
+
+void MidiInApi::MidiSlot :: assign( const std::vector<unsigned char>& message, double stamp, unsigned long long absolute )
+{
+  assign( message.data(), message.size(), stamp, absolute );
+}
+
+void MidiInApi::MidiSlot :: assign( const unsigned char *message, unsigned int messageSize, double stamp, unsigned long long absolute )
+{
+  size = messageSize;
+  timeStamp = stamp;
+  absoluteTime = absolute;
+  if ( size == 0 ) return;
+  if ( size <= INLINE_SIZE ) {
+    memcpy( bytes, message, size );
+    return;
+  }
+
+  // Sysex: grow the overflow buffer if needed but never shrink it.
+  if ( overflow.size() < size ) overflow.resize( size );
+  memcpy( &overflow[0], message, size );
+}
+
+void MidiInApi::MidiSlot :: swap( std::vector<unsigned char>& message, double stamp, unsigned long long absolute )
+{
+  if ( message.size() <= INLINE_SIZE ) {
+    assign( message, stamp, absolute );
+    return;
+  }
+
+  // Sysex: take over the message storage and hand the old overflow
+  // buffer back to the caller for reuse.
+  size = message.size();
+  timeStamp = stamp;
+  absoluteTime = absolute;
+  overflow.swap( message );
+}
+
+void MidiInApi::MidiQueue :: allocate( unsigned int size )
+{
+  // One extra slot so that the ring can hold size messages.
+  free();
+  ringSize = size + 1;
+  ring = new MidiSlot[ ringSize ];
+}
+
+void MidiInApi::MidiQueue :: free( void )
+{
+  delete [] ring;
+  ring = 0;
+  ringSize = 0;
+  front.store( 0, std::memory_order_relaxed );
+  back.store( 0, std::memory_order_relaxed );
+}
+
+bool MidiInApi::MidiQueue :: push( const MidiInApi::MidiMessage& message )
+{
+  return push( message.bytes, message.timeStamp, message.absoluteTime );
+}
+
+bool MidiInApi::MidiQueue :: push( const std::vector<unsigned char>& bytes, double timeStamp, unsigned long long absoluteTime )
+{
+  return push( bytes.data(), bytes.size(), timeStamp, absoluteTime );
+}
+
+bool MidiInApi::MidiQueue :: push( const unsigned char *bytes, unsigned int size, double timeStamp, unsigned long long absoluteTime )
+{
+  if ( ringSize == 0 ) return false;
+
+  // Only the producer writes back, so its own index can be read relaxed.
+  // The acquire load of front pairs with the release store in pop() so
+  // the slot is not overwritten before the consumer is done with it.
+  unsigned int b = back.load( std::memory_order_relaxed );
+  unsigned int next = b + 1;
+  if ( next == ringSize ) next = 0;
+  if ( next == front.load( std::memory_order_acquire ) ) return false;
+
+  // Copy the message into the free slot and then publish it.
+  ring[b].assign( bytes, size, timeStamp, absoluteTime );
+  back.store( next, std::memory_order_release );
+  return true;
+}
+
+bool MidiInApi::MidiQueue :: pushSwap( MidiInApi::MidiMessage& message )
+{
+  if ( ringSize == 0 ) return false;
+
+  // Same as push() but swaps the message into the slot.
+  unsigned int b = back.load( std::memory_order_relaxed );
+  unsigned int next = b + 1;
+  if ( next == ringSize ) next = 0;
+  if ( next == front.load( std::memory_order_acquire ) ) return false;
+  ring[b].swap( message.bytes, message.timeStamp, message.absoluteTime );
+  back.store( next, std::memory_order_release );
+  return true;
+}
+
+bool MidiInApi::MidiQueue :: pop( std::vector<unsigned char> *message, double *timeStamp, unsigned long long *absoluteTime )
+{
+  if ( ringSize == 0 ) return false;
+
+  // The acquire load of back pairs with the release store in push() so
+  // the slot contents are visible before they are read.
+  unsigned int f = front.load( std::memory_order_relaxed );
+  if ( f == back.load( std::memory_order_acquire ) ) return false;
 
   // Copy queued message to the vector pointer argument and then "pop" it.
-  std::vector<unsigned char> *bytes = &(inputData_.queue.ring[inputData_.queue.front].bytes);
-  message->assign( bytes->begin(), bytes->end() );
-  double deltaTime = inputData_.queue.ring[inputData_.queue.front].timeStamp;
-  inputData_.queue.size--;
-  inputData_.queue.front++;
-  if ( inputData_.queue.front == inputData_.queue.ringSize )
-    inputData_.queue.front = 0;
+  // Sysex is swapped out instead, the slot keeps the caller's old
+  // vector as its overflow buffer.
+  MidiSlot& slot = ring[f];
+  if ( slot.size > MidiSlot::INLINE_SIZE ) {
+    message->swap( slot.overflow );
+    message->resize( slot.size );
+  }
+  else
+    message->assign( slot.bytes, slot.bytes + slot.size );
+  *timeStamp = slot.timeStamp;
+  if ( absoluteTime ) *absoluteTime = slot.absoluteTime;
+  unsigned int next = f + 1;
+  if ( next == ringSize ) next = 0;
+  front.store( next, std::memory_order_release );
+  return true;
+}
 
-  return deltaTime;
+bool MidiInApi::MidiQueue :: peek( double *timeStamp, unsigned long long *absoluteTime ) const
+{
+  if ( ringSize == 0 ) return false;
+
+  // Consumer side only, like pop() but leaves the message in place.
+  unsigned int f = front.load( std::memory_order_relaxed );
+  if ( f == back.load( std::memory_order_acquire ) ) return false;
+  *timeStamp = ring[f].timeStamp;
+  if ( absoluteTime ) *absoluteTime = ring[f].absoluteTime;
+  return true;
+}
+
+unsigned int MidiInApi::MidiQueue :: size( void ) const
+{
+  // A snapshot only, either side may move on right after this returns.
+  unsigned int f = front.load( std::memory_order_acquire );
+  unsigned int b = back.load( std::memory_order_acquire );
+  if ( b >= f ) return b - f;
+  return ringSize - f + b;
 }
 
 //*********************************************************************//
@@ -370,6 +542,37 @@ MidiOutApi :: ~MidiOutApi( void )
 {
 }
 
+void MidiOutApi :: sendBytes( const unsigned char *message, size_t size )
+{
+  std::vector<unsigned char> bytes( message, message + size );
+  sendMessage( &bytes );
+}
+
+void MidiOutApi :: sendMessages( std::vector<unsigned char> *messages, unsigned int count )
+{
+  for ( unsigned int i=0; i<count; ++i ) sendMessage( &messages[i] );
+}
+
+void MidiOutApi :: setOutputBufferSize( unsigned int /*size*/ )
+{
+  errorString_ = "MidiOutApi::setOutputBufferSize: output buffer size is not supported by this API.";
+  error( RtMidiError::WARNING, errorString_ );
+}
+
+void MidiOutApi :: sendMessageAt( std::vector<unsigned char> *message, double /*timeStamp*/ )
+{
+  errorString_ = "MidiOutApi::sendMessageAt: scheduled output is not supported by this API, sending immediately.";
+  error( RtMidiError::WARNING, errorString_ );
+  sendMessage( message );
+}
+
+double MidiOutApi :: getQueueTime( void )
+{
+  errorString_ = "MidiOutApi::getQueueTime: scheduled output is not supported by this API.";
+  error( RtMidiError::WARNING, errorString_ );
+  return 0.0;
+}
+
 // *************************************************** //
 //
 // OS/API-specific methods.
@@ -450,6 +653,15 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
     if ( apiData->lastTime == 0 ) { // this happens when receiving asynchronous sysex messages
       apiData->lastTime = AudioGetCurrentHostTime();
     }
+
+    // The absolute time is the steady clock time less the packet's
+    // age, as host time and the steady clock need not share a base.
+    if ( !continueSysex ) {
+      unsigned long long now = AudioGetCurrentHostTime();
+      message.absoluteTime = monotonicNanos();
+      if ( packet->timeStamp != 0 && packet->timeStamp < now )
+        message.absoluteTime -= AudioConvertHostTimeToNanos( now - packet->timeStamp );
+    }
     //std::cout << "TimeStamp = " << packet->timeStamp << std::endl;
 
     iByte = 0;
@@ -466,17 +678,12 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
         // If not a continuing sysex message, invoke the user callback function or queue the message.
         if ( data->usingCallback ) {
           RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
+          data->messageTime = message.absoluteTime;
           callback( message.timeStamp, &message.bytes, data->userData );
         }
         else {
           // As long as we haven't reached our queue size limit, push the message.
-          if ( data->queue.size < data->queue.ringSize ) {
-            data->queue.ring[data->queue.back++] = message;
-            if ( data->queue.back == data->queue.ringSize )
-              data->queue.back = 0;
-            data->queue.size++;
-          }
-          else
+          if ( !data->queue.push( message ) )
             std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
         }
         message.bytes.clear();
@@ -530,17 +737,12 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
             // If not a continuing sysex message, invoke the user callback function or queue the message.
             if ( data->usingCallback ) {
               RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
+              data->messageTime = message.absoluteTime;
               callback( message.timeStamp, &message.bytes, data->userData );
             }
             else {
               // As long as we haven't reached our queue size limit, push the message.
-              if ( data->queue.size < data->queue.ringSize ) {
-                data->queue.ring[data->queue.back++] = message;
-                if ( data->queue.back == data->queue.ringSize )
-                  data->queue.back = 0;
-                data->queue.size++;
-              }
-              else
+              if ( !data->queue.push( message ) )
                 std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
             }
             message.bytes.clear();
@@ -1088,6 +1290,7 @@ void MidiOutCore :: sendMessage( std::vector<unsigned char> *message )
 // preprocessor definition AVOID_TIMESTAMPING to save resources
 // associated with the ALSA sequencer queues.
 
+#include <errno.h>
 #include <pthread.h>
 #include <sys/time.h>
 
@@ -1103,10 +1306,12 @@ struct AlsaMidiData {
   snd_seq_port_subscribe_t *subscription;
   snd_midi_event_t *coder;
   unsigned int bufferSize;
-  unsigned char *buffer;
+  unsigned char runningStatus; // last channel status sent without the coder, 0 if none
+  bool inSysex; // a partial sysex message was sent, expecting more data or F7
   pthread_t thread;
   pthread_t dummy_thread_id;
   unsigned long long lastTime;
+  unsigned long long queueStart; // steady clock nanos when the input queue was started
   int queue_id; // an input queue is needed to get timestamped events
   int trigger_fds[2];
 };
@@ -1127,6 +1332,7 @@ static void *alsaMidiHandler( void *ptr )
   unsigned long long time, lastTime;
   bool continueSysex = false;
   bool doDecode = false;
+  bool doSysex = false;
   MidiInApi::MidiMessage message;
   int poll_fd_count;
   struct pollfd *poll_fds;
@@ -1188,6 +1394,7 @@ static void *alsaMidiHandler( void *ptr )
     if ( !continueSysex ) message.bytes.clear();
 
     doDecode = false;
+    doSysex = false;
     switch ( ev->type ) {
 
     case SND_SEQ_EVENT_PORT_SUBSCRIBED:
@@ -1225,36 +1432,44 @@ static void *alsaMidiHandler( void *ptr )
 
 		case SND_SEQ_EVENT_SYSEX:
       if ( (data->ignoreFlags & 0x01) ) break;
-      if ( ev->data.ext.len > apiData->bufferSize ) {
-        apiData->bufferSize = ev->data.ext.len;
-        free( buffer );
-        buffer = (unsigned char *) malloc( apiData->bufferSize );
-        if ( buffer == NULL ) {
-          data->doInput = false;
-          std::cerr << "\nMidiInAlsa::alsaMidiHandler: error resizing buffer memory!\n\n";
-          break;
-        }
-      }
+      doSysex = true;
+      break;
 
     default:
       doDecode = true;
     }
 
-    if ( doDecode ) {
-
+    nBytes = 0;
+    if ( doSysex ) {
+
+      // The ALSA sequencer has a maximum buffer size for MIDI sysex
+      // events of 256 bytes.  If a device sends sysex messages larger
+      // than this, they are segmented into 256 byte chunks.  So,
+      // we'll watch for this and concatenate sysex chunks into a
+      // single sysex message if necessary, unless the user asked for
+      // the chunks as they are with setSysexChunking().  The chunks are
+      // appended straight from the event, growing the message at least
+      // twofold so a large dump is not reallocated for every chunk.
+      const unsigned char *chunk = (const unsigned char *) ev->data.ext.ptr;
+      nBytes = ev->data.ext.len;
+      size_t size = message.bytes.size() + nBytes;
+      if ( size > message.bytes.capacity() )
+        message.bytes.reserve( std::max( size, 2 * message.bytes.capacity() ) );
+      message.bytes.insert( message.bytes.end(), chunk, chunk + nBytes );
+    }
+    else if ( doDecode ) {
       nBytes = snd_midi_event_decode( apiData->coder, buffer, apiData->bufferSize, ev );
       if ( nBytes > 0 ) {
-        // The ALSA sequencer has a maximum buffer size for MIDI sysex
-        // events of 256 bytes.  If a device sends sysex messages larger
-        // than this, they are segmented into 256 byte chunks.  So,
-        // we'll watch for this and concatenate sysex chunks into a
-        // single sysex message if necessary.
         if ( !continueSysex )
           message.bytes.assign( buffer, &buffer[nBytes] );
         else
           message.bytes.insert( message.bytes.end(), buffer, &buffer[nBytes] );
+      }
+    }
 
-        continueSysex = ( ( ev->type == SND_SEQ_EVENT_SYSEX ) && ( message.bytes.back() != 0xF7 ) );
+    if ( doSysex || doDecode ) {
+      if ( nBytes > 0 ) {
+        continueSysex = ( doSysex && !data->sysexChunking && ( message.bytes.back() != 0xF7 ) );
         if ( !continueSysex ) {
 
           // Calculate the time stamp:
@@ -1274,6 +1489,13 @@ static void *alsaMidiHandler( void *ptr )
             data->firstMessage = false;
           else
             message.timeStamp = time * 0.000001;
+
+          // The event time is real time since the queue was started.
+#ifndef AVOID_TIMESTAMPING
+          message.absoluteTime = apiData->queueStart + ev->time.time.tv_sec * 1000000000ULL + ev->time.time.tv_nsec;
+#else
+          message.absoluteTime = monotonicNanos();
+#endif
         }
         else {
 #if defined(__RTMIDI_DEBUG__)
@@ -1288,17 +1510,13 @@ static void *alsaMidiHandler( void *ptr )
 
     if ( data->usingCallback ) {
       RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
+      data->messageTime = message.absoluteTime;
       callback( message.timeStamp, &message.bytes, data->userData );
     }
     else {
-      // As long as we haven't reached our queue size limit, push the message.
-      if ( data->queue.size < data->queue.ringSize ) {
-        data->queue.ring[data->queue.back++] = message;
-        if ( data->queue.back == data->queue.ringSize )
-          data->queue.back = 0;
-        data->queue.size++;
-      }
-      else
+      // As long as we haven't reached our queue size limit, push the
+      // message.  It's swapped in, so a large sysex is not copied again.
+      if ( !data->queue.pushSwap( message ) )
         std::cerr << "\nMidiInAlsa: message queue limit reached!!\n\n";
     }
   }
@@ -1539,6 +1757,7 @@ void MidiInAlsa :: openPort( unsigned int portNumber, const std::string portName
 #ifndef AVOID_TIMESTAMPING
     snd_seq_start_queue( data->seq, data->queue_id, NULL );
     snd_seq_drain_output( data->seq );
+    data->queueStart = monotonicNanos();
 #endif
     // Start our MIDI input thread.
     pthread_attr_t attr;
@@ -1601,6 +1820,7 @@ void MidiInAlsa :: openVirtualPort( std::string portName )
 #ifndef AVOID_TIMESTAMPING
     snd_seq_start_queue( data->seq, data->queue_id, NULL );
     snd_seq_drain_output( data->seq );
+    data->queueStart = monotonicNanos();
 #endif
     // Start our MIDI input thread.
     pthread_attr_t attr;
@@ -1658,6 +1878,82 @@ void MidiInAlsa :: closePort( void )
 //  Class Definitions: MidiOutAlsa
 //*********************************************************************//
 
+// Drain the output buffer until nothing is pending.  The client is
+// non-blocking, so a full kernel pool leaves events behind with -EAGAIN
+// and we wait for it to make room.  Returns false if events are still
+// pending after about a second or on any other error.
+static bool alsaDrainAll( snd_seq_t *seq )
+{
+  int timeouts = 0;
+  while ( true ) {
+    int result = snd_seq_drain_output( seq );
+    if ( result == 0 ) return true;
+    if ( result < 0 && result != -EAGAIN ) return false;
+
+    int count = snd_seq_poll_descriptors_count( seq, POLLOUT );
+    struct pollfd *fds = (struct pollfd *) alloca( count * sizeof( struct pollfd ) );
+    snd_seq_poll_descriptors( seq, fds, count, POLLOUT );
+    if ( poll( fds, count, 100 ) == 0 && ++timeouts == 10 ) return false;
+  }
+}
+
+// Fill in a sequencer event directly for complete channel and realtime
+// messages, skipping the MIDI event coder.  Returns false for anything
+// else, ie. sysex and system common messages, which should be encoded.
+static bool alsaDirectEvent( AlsaMidiData *data, const unsigned char *bytes,
+                             unsigned int nBytes, snd_seq_event_t *ev )
+{
+  unsigned char status = bytes[0];
+  if ( status >= 0xF8 ) {
+    if ( nBytes != 1 ) return false;
+    switch ( status ) {
+    case 0xF8: ev->type = SND_SEQ_EVENT_CLOCK; break;
+    case 0xF9: ev->type = SND_SEQ_EVENT_TICK; break;
+    case 0xFA: ev->type = SND_SEQ_EVENT_START; break;
+    case 0xFB: ev->type = SND_SEQ_EVENT_CONTINUE; break;
+    case 0xFC: ev->type = SND_SEQ_EVENT_STOP; break;
+    case 0xFE: ev->type = SND_SEQ_EVENT_SENSING; break;
+    case 0xFF: ev->type = SND_SEQ_EVENT_RESET; break;
+    default: return false;
+    }
+    snd_seq_ev_set_fixed( ev );
+    return true;
+  }
+  if ( status >= 0xF0 ) {
+    // System common messages cancel running status.
+    data->runningStatus = 0;
+    return false;
+  }
+
+  // Data bytes only, use running status if we know it.
+  const unsigned char *values = bytes + 1;
+  unsigned int nValues = nBytes - 1;
+  if ( status < 0x80 ) {
+    if ( data->runningStatus == 0 ) return false;
+    status = data->runningStatus;
+    values = bytes;
+    nValues = nBytes;
+  }
+  unsigned int expected = ( ( status & 0xE0 ) == 0xC0 ) ? 1 : 2; // program change & channel pressure
+  if ( nValues != expected ) return false;
+  for ( unsigned int i=0; i<nValues; ++i ) {
+    if ( values[i] & 0x80 ) return false;
+  }
+
+  int channel = status & 0x0F;
+  switch ( status & 0xF0 ) {
+  case 0x80: snd_seq_ev_set_noteoff( ev, channel, values[0], values[1] ); break;
+  case 0x90: snd_seq_ev_set_noteon( ev, channel, values[0], values[1] ); break;
+  case 0xA0: snd_seq_ev_set_keypress( ev, channel, values[0], values[1] ); break;
+  case 0xB0: snd_seq_ev_set_controller( ev, channel, values[0], values[1] ); break;
+  case 0xC0: snd_seq_ev_set_pgmchange( ev, channel, values[0] ); break;
+  case 0xD0: snd_seq_ev_set_chanpress( ev, channel, values[0] ); break;
+  case 0xE0: snd_seq_ev_set_pitchbend( ev, channel, ( values[0] | ( values[1] << 7 ) ) - 8192 ); break;
+  }
+  data->runningStatus = status;
+  return true;
+}
+
 MidiOutAlsa :: MidiOutAlsa( const std::string clientName ) : MidiOutApi()
 {
   initialize( clientName );
@@ -1672,7 +1968,7 @@ MidiOutAlsa :: ~MidiOutAlsa()
   AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
   if ( data->vport >= 0 ) snd_seq_delete_port( data->seq, data->vport );
   if ( data->coder ) snd_midi_event_free( data->coder );
-  if ( data->buffer ) free( data->buffer );
+  if ( data->queue_id >= 0 ) snd_seq_free_queue( data->seq, data->queue_id );
   snd_seq_close( data->seq );
   delete data;
 }
@@ -1698,7 +1994,9 @@ void MidiOutAlsa :: initialize( const std::string& clientName )
   data->vport = -1;
   data->bufferSize = 32;
   data->coder = 0;
-  data->buffer = 0;
+  data->runningStatus = 0;
+  data->inSysex = false;
+  data->queue_id = -1; // allocated by the first scheduled message
   int result = snd_midi_event_new( data->bufferSize, &data->coder );
   if ( result < 0 ) {
     delete data;
@@ -1706,13 +2004,6 @@ void MidiOutAlsa :: initialize( const std::string& clientName )
     error( RtMidiError::DRIVER_ERROR, errorString_ );
     return;
   }
-  data->buffer = (unsigned char *) malloc( data->bufferSize );
-  if ( data->buffer == NULL ) {
-    delete data;
-    errorString_ = "MidiOutAlsa::initialize: error allocating buffer memory!\n\n";
-    error( RtMidiError::MEMORY_ERROR, errorString_ );
-    return;
-  }
   snd_midi_event_init( data->coder );
   apiData_ = (void *) data;
 }
@@ -1845,25 +2136,88 @@ void MidiOutAlsa :: openVirtualPort( std::string portName )
 }
 
 void MidiOutAlsa :: sendMessage( std::vector<unsigned char> *message )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( outputMessage( message->data(), message->size() ) ) snd_seq_drain_output( data->seq );
+}
+
+void MidiOutAlsa :: sendBytes( const unsigned char *message, size_t size )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( outputMessage( message, size ) ) snd_seq_drain_output( data->seq );
+}
+
+void MidiOutAlsa :: sendMessages( std::vector<unsigned char> *messages, unsigned int count )
+{
+  // Queue the whole batch, snd_seq_event_output() only drains on its
+  // own when the output buffer is full, then drain once.
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  bool queued = false;
+  for ( unsigned int i=0; i<count; ++i ) {
+    if ( outputMessage( messages[i].data(), messages[i].size() ) ) queued = true;
+  }
+  if ( queued ) snd_seq_drain_output( data->seq );
+}
+
+void MidiOutAlsa :: setOutputBufferSize( unsigned int size )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( snd_seq_set_output_buffer_size( data->seq, size ) < 0 ) {
+    errorString_ = "MidiOutAlsa::setOutputBufferSize: error setting the output buffer size.";
+    error( RtMidiError::WARNING, errorString_ );
+  }
+}
+
+void MidiOutAlsa :: sendMessageAt( std::vector<unsigned char> *message, double timeStamp )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( !startQueue() ) return;
+  if ( timeStamp < 0.0 ) timeStamp = 0.0;
+  if ( outputMessage( message->data(), message->size(), timeStamp ) ) snd_seq_drain_output( data->seq );
+}
+
+double MidiOutAlsa :: getQueueTime( void )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( !startQueue() ) return 0.0;
+
+  snd_seq_queue_status_t *status;
+  snd_seq_queue_status_alloca( &status );
+  if ( snd_seq_get_queue_status( data->seq, data->queue_id, status ) < 0 ) {
+    errorString_ = "MidiOutAlsa::getQueueTime: error getting the output queue status.";
+    error( RtMidiError::WARNING, errorString_ );
+    return 0.0;
+  }
+  const snd_seq_real_time_t *time = snd_seq_queue_status_get_real_time( status );
+  return time->tv_sec + time->tv_nsec * 0.000000001;
+}
+
+bool MidiOutAlsa :: startQueue( void )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( data->queue_id >= 0 ) return true;
+
+  // The queue runs in real time from 0, events scheduled on it are
+  // held by the sequencer until their time has come.
+  data->queue_id = snd_seq_alloc_named_queue( data->seq, "RtMidi Output Queue" );
+  if ( data->queue_id < 0 ) {
+    errorString_ = "MidiOutAlsa::startQueue: error allocating the output queue.";
+    error( RtMidiError::DRIVER_ERROR, errorString_ );
+    return false;
+  }
+  snd_seq_start_queue( data->seq, data->queue_id, NULL );
+  snd_seq_drain_output( data->seq );
+  return true;
+}
+
+bool MidiOutAlsa :: outputMessage( const unsigned char *bytes, unsigned int nBytes, double timeStamp )
 {
   int result;
   AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
-  unsigned int nBytes = message->size();
-  if ( nBytes > data->bufferSize ) {
-    data->bufferSize = nBytes;
-    result = snd_midi_event_resize_buffer ( data->coder, nBytes);
-    if ( result != 0 ) {
-      errorString_ = "MidiOutAlsa::sendMessage: ALSA error resizing MIDI event buffer.";
-      error( RtMidiError::DRIVER_ERROR, errorString_ );
-      return;
-    }
-    free (data->buffer);
-    data->buffer = (unsigned char *) malloc( data->bufferSize );
-    if ( data->buffer == NULL ) {
-    errorString_ = "MidiOutAlsa::initialize: error allocating buffer memory!\n\n";
-    error( RtMidiError::MEMORY_ERROR, errorString_ );
-    return;
-    }
+  if ( nBytes == 0 ) {
+    errorString_ = "MidiOutAlsa::outputMessage: no data in message argument!";
+    error( RtMidiError::WARNING, errorString_ );
+    return false;
   }
 
   snd_seq_event_t ev;
@@ -1871,22 +2225,80 @@ void MidiOutAlsa :: sendMessage( std::vector<unsigned char> *message )
   snd_seq_ev_set_source(&ev, data->vport);
   snd_seq_ev_set_subs(&ev);
   snd_seq_ev_set_direct(&ev);
-  for ( unsigned int i=0; i<nBytes; ++i ) data->buffer[i] = message->at(i);
-  result = snd_midi_event_encode( data->coder, data->buffer, (long)nBytes, &ev );
-  if ( result < (int)nBytes ) {
-    errorString_ = "MidiOutAlsa::sendMessage: event parsing error!";
-    error( RtMidiError::WARNING, errorString_ );
-    return;
+  // Data bytes & F7 continue a partial sysex message, any other status
+  // byte except realtime ends it.
+  bool sysex = ( bytes[0] == 0xF0 );
+  if ( data->inSysex ) {
+    if ( bytes[0] < 0x80 || bytes[0] == 0xF7 ) sysex = true;
+    else if ( bytes[0] < 0xF8 ) data->inSysex = false;
+  }
+  if ( sysex ) {
+
+    // Sysex messages, or chunks of one, are passed on as is, pointing
+    // at the caller's memory.  The whole event has to fit into the
+    // output buffer, which drops anything pending when resized, so
+    // everything queued so far, ie. by sendMessages(), goes out first.
+    size_t eventSize = sizeof( snd_seq_event_t ) + nBytes;
+    if ( eventSize > snd_seq_get_output_buffer_size( data->seq ) ) {
+      if ( !alsaDrainAll( data->seq ) ) {
+        errorString_ = "MidiOutAlsa::outputMessage: error draining pending events before resizing the output buffer for sysex.";
+        error( RtMidiError::WARNING, errorString_ );
+        return false;
+      }
+      if ( snd_seq_set_output_buffer_size( data->seq, eventSize ) < 0 ) {
+        errorString_ = "MidiOutAlsa::outputMessage: error resizing the output buffer for sysex.";
+        error( RtMidiError::WARNING, errorString_ );
+        return false;
+      }
+    }
+    snd_seq_ev_set_sysex( &ev, nBytes, (void *) bytes );
+    data->runningStatus = 0;
+    data->inSysex = ( bytes[nBytes - 1] != 0xF7 );
+  }
+  else if ( !alsaDirectEvent( data, bytes, nBytes, &ev ) ) {
+
+    // Anything else goes through the coder.  Its buffer holds a whole
+    // sysex message and only ever grows, doubling to keep resizes rare.
+    if ( nBytes > data->bufferSize ) {
+      unsigned int bufferSize = data->bufferSize;
+      while ( bufferSize < nBytes ) bufferSize *= 2;
+      result = snd_midi_event_resize_buffer( data->coder, bufferSize );
+      if ( result != 0 ) {
+        errorString_ = "MidiOutAlsa::outputMessage: ALSA error resizing MIDI event buffer.";
+        error( RtMidiError::DRIVER_ERROR, errorString_ );
+        return false;
+      }
+      data->bufferSize = bufferSize;
+    }
+    result = snd_midi_event_encode( data->coder, bytes, (long)nBytes, &ev );
+    if ( result < (int)nBytes ) {
+      errorString_ = "MidiOutAlsa::outputMessage: event parsing error!";
+      error( RtMidiError::WARNING, errorString_ );
+      return false;
+    }
+  }
+  if ( timeStamp >= 0.0 ) {
+    snd_seq_real_time_t time;
+    time.tv_sec = (unsigned int) timeStamp;
+    time.tv_nsec = (unsigned int) ( ( timeStamp - time.tv_sec ) * 1000000000.0 );
+    snd_seq_ev_schedule_real( &ev, data->queue_id, 0, &time );
   }
 
   // Send the event.
   result = snd_seq_event_output(data->seq, &ev);
+  if ( result == -EAGAIN ) {
+    // The sequencer is opened non-blocking, so a full output pool
+    // shows up here instead of blocking.
+    errorString_ = "MidiOutAlsa::outputMessage: output buffer full, message not sent.";
+    error( RtMidiError::BUFFER_FULL, errorString_ );
+    return false;
+  }
   if ( result < 0 ) {
-    errorString_ = "MidiOutAlsa::sendMessage: error sending MIDI message to port.";
+    errorString_ = "MidiOutAlsa::outputMessage: error sending MIDI message to port.";
     error( RtMidiError::WARNING, errorString_ );
-    return;
+    return false;
   }
-  snd_seq_drain_output(data->seq);
+  return true;
 }
 
 #endif // __LINUX_ALSA__
@@ -1949,6 +2361,7 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
   }
   else apiData->message.timeStamp = (double) ( timestamp - apiData->lastTime ) * 0.001;
   apiData->lastTime = timestamp;
+  apiData->message.absoluteTime = monotonicNanos(); // The time stamp is only in millis
 
   if ( inputStatus == MIM_DATA ) { // Channel or system message
 
@@ -2011,17 +2424,12 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
 
   if ( data->usingCallback ) {
     RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
+    data->messageTime = apiData->message.absoluteTime;
     callback( apiData->message.timeStamp, &apiData->message.bytes, data->userData );
   }
   else {
     // As long as we haven't reached our queue size limit, push the message.
-    if ( data->queue.size < data->queue.ringSize ) {
-      data->queue.ring[data->queue.back++] = apiData->message;
-      if ( data->queue.back == data->queue.ringSize )
-        data->queue.back = 0;
-      data->queue.size++;
-    }
-    else
+    if ( !data->queue.push( apiData->message ) )
       std::cerr << "\nRtMidiIn: message queue limit reached!!\n\n";
   }
 
@@ -2467,16 +2875,17 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
   // We have midi events in buffer
   int evCount = jack_midi_get_event_count( buff );
   for (int j = 0; j < evCount; j++) {
-    MidiInApi::MidiMessage message;
-    message.bytes.clear();
+    // Reuse the shared message so its byte buffer is not reallocated
+    // for every event in the process callback.
+    MidiInApi::MidiMessage& message = rtData->message;
 
     jack_midi_event_get( &event, buff, j );
 
-    for ( unsigned int i = 0; i < event.size; i++ )
-      message.bytes.push_back( event.buffer[i] );
+    message.bytes.assign( event.buffer, event.buffer + event.size );
 
     // Compute the delta time.
     time = jack_get_time();
+    message.timeStamp = 0.0;
     if ( rtData->firstMessage == true )
       rtData->firstMessage = false;
     else
@@ -2484,20 +2893,22 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
 
     jData->lastTime = time;
 
+    // The absolute time is the steady clock time less the event's age
+    // on the JACK clock, from its frame time within this cycle.
+    jack_time_t eventTime = jack_frames_to_time( jData->client, jack_last_frame_time( jData->client ) + event.time );
+    message.absoluteTime = monotonicNanos();
+    if ( eventTime < time )
+      message.absoluteTime -= ( time - eventTime ) * 1000;
+
     if ( !rtData->continueSysex ) {
       if ( rtData->usingCallback ) {
         RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) rtData->userCallback;
+        rtData->messageTime = message.absoluteTime;
         callback( message.timeStamp, &message.bytes, rtData->userData );
       }
       else {
         // As long as we haven't reached our queue size limit, push the message.
-        if ( rtData->queue.size < rtData->queue.ringSize ) {
-          rtData->queue.ring[rtData->queue.back++] = message;
-          if ( rtData->queue.back == rtData->queue.ringSize )
-            rtData->queue.back = 0;
-          rtData->queue.size++;
-        }
-        else
+        if ( !rtData->queue.push( message ) )
           std::cerr << "\nMidiInJack: message queue limit reached!!\n\n";
       }
     }
@@ -2827,13 +3238,581 @@ void MidiOutJack :: closePort()
 
 void MidiOutJack :: sendMessage( std::vector<unsigned char> *message )
 {
-  int nBytes = message->size();
+  sendBytes( message->data(), message->size() );
+}
+
+void MidiOutJack :: sendBytes( const unsigned char *message, size_t size )
+{
+  int nBytes = size;
   JackMidiData *data = static_cast<JackMidiData *> (apiData_);
 
+  // Drop the message instead of writing it partially, the process
+  // callback can't make sense of a truncated message.
+  if ( jack_ringbuffer_write_space( data->buffMessage ) < size ||
+       jack_ringbuffer_write_space( data->buffSize ) < sizeof( nBytes ) ) {
+    errorString_ = "MidiOutJack::sendMessage: ringbuffer full, message dropped.";
+    error( RtMidiError::BUFFER_FULL, errorString_ );
+    return;
+  }
+
   // Write full message to buffer
-  jack_ringbuffer_write( data->buffMessage, ( const char * ) &( *message )[0],
-                         message->size() );
+  jack_ringbuffer_write( data->buffMessage, ( const char * ) message, size );
   jack_ringbuffer_write( data->buffSize, ( char * ) &nBytes, sizeof( nBytes ) );
 }
 
 #endif  // __UNIX_JACK__
+
+//*********************************************************************//
+//  API: Loopback
+//
+//  In-process ports for testing without MIDI hardware or drivers.
+//
+//*********************************************************************//
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define LOOPBACK_QUEUE_SIZE 1024 // Messages in flight per input
+#define LOOPBACK_THROUGH_NAME "Loopback Through Port-"
+#define LOOPBACK_THROUGH_PORTS 4 // So several ports can be tested at once
+
+struct LoopbackInput;
+
+// A port which outputs send to and inputs connect to.
+struct LoopbackPort {
+  std::string name;
+  std::mutex mutex; // Guards inputs, held while sending
+  std::vector<LoopbackInput *> inputs;
+};
+
+// A structure to hold variables related to a loopback input, the
+// queue holds sent messages with their absolute send times.
+struct LoopbackInput {
+  MidiInApi :: RtMidiInData *rtData;
+  MidiInApi :: MidiQueue queue;
+  std::mutex pushMutex; // Serializes senders on different ports
+  std::shared_ptr<LoopbackPort> port;
+  std::shared_ptr<LoopbackPort> vport;
+  std::thread thread;
+  std::atomic<bool> running;
+  std::atomic<bool> waiting;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  unsigned long long lastTime;
+};
+
+// A structure to hold variables related to a loopback output.
+struct LoopbackOutput {
+  std::shared_ptr<LoopbackPort> port;
+  std::shared_ptr<LoopbackPort> vport;
+};
+
+// The listed ports, the through ports are always first.  Only touched
+// when opening and closing ports, never while sending.
+static std::mutex loopbackMutex;
+
+static std::vector< std::shared_ptr<LoopbackPort> >& loopbackPorts( void )
+{
+  static std::vector< std::shared_ptr<LoopbackPort> > ports;
+  if ( ports.empty() ) {
+    for ( unsigned int i=0; i<LOOPBACK_THROUGH_PORTS; ++i ) {
+      ports.push_back( std::make_shared<LoopbackPort>() );
+      ports[i]->name = LOOPBACK_THROUGH_NAME + std::to_string( i );
+    }
+  }
+  return ports;
+}
+
+static unsigned int loopbackPortCount( void )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  return loopbackPorts().size();
+}
+
+static std::string loopbackPortName( unsigned int portNumber )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  std::vector< std::shared_ptr<LoopbackPort> >& ports = loopbackPorts();
+  if ( portNumber >= ports.size() ) return "";
+  return ports[portNumber]->name;
+}
+
+static std::shared_ptr<LoopbackPort> loopbackFindPort( unsigned int portNumber )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  std::vector< std::shared_ptr<LoopbackPort> >& ports = loopbackPorts();
+  if ( portNumber >= ports.size() ) return std::shared_ptr<LoopbackPort>();
+  return ports[portNumber];
+}
+
+static std::shared_ptr<LoopbackPort> loopbackAddPort( const std::string& name )
+{
+  std::shared_ptr<LoopbackPort> port = std::make_shared<LoopbackPort>();
+  port->name = name;
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  loopbackPorts().push_back( port );
+  return port;
+}
+
+// Unlist a port, connected inputs & outputs keep it until they close.
+static void loopbackRemovePort( const std::shared_ptr<LoopbackPort>& port )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  std::vector< std::shared_ptr<LoopbackPort> >& ports = loopbackPorts();
+  ports.erase( std::remove( ports.begin(), ports.end(), port ), ports.end() );
+}
+
+static void loopbackConnect( LoopbackPort *port, LoopbackInput *input )
+{
+  std::lock_guard<std::mutex> lock( port->mutex );
+  port->inputs.push_back( input );
+}
+
+static void loopbackDisconnect( LoopbackPort *port, LoopbackInput *input )
+{
+  std::lock_guard<std::mutex> lock( port->mutex );
+  port->inputs.erase( std::remove( port->inputs.begin(), port->inputs.end(), input ),
+                      port->inputs.end() );
+}
+
+// Wake up the input thread if it is waiting.
+static void loopbackWake( LoopbackInput *input )
+{
+  // Pairs with the fence in loopbackMidiHandler() so either the input
+  // thread sees the message or we see it waiting.
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+  if ( input->waiting.load( std::memory_order_relaxed ) ) {
+    std::lock_guard<std::mutex> lock( input->mutex );
+    input->wakeup.notify_one();
+  }
+}
+
+// Push a message to an input queue, the caller holds the push mutex.
+// If the queue is full, wake the input thread and wait for it to make
+// room like a blocking driver write would.  Messages are stamped in
+// push order so times never go backwards.  Returns false if the input
+// was stopped.
+static bool loopbackQueue( LoopbackInput *input, const unsigned char *message, size_t size )
+{
+  unsigned long long time = monotonicNanos();
+  while ( !input->queue.push( message, size, 0.0, time ) ) {
+    if ( !input->running.load( std::memory_order_relaxed ) ) return false;
+    loopbackWake( input );
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+// Push a message to an input queue and wake up the input thread.
+static void loopbackPush( LoopbackInput *input, const unsigned char *message, size_t size )
+{
+  {
+    std::lock_guard<std::mutex> lock( input->pushMutex );
+    if ( !loopbackQueue( input, message, size ) ) return;
+  }
+  loopbackWake( input );
+}
+
+//*********************************************************************//
+//  API: Loopback
+//  Class Definitions: MidiInLoopback
+//*********************************************************************//
+
+// Time stamp and hand a received message to the callback or queue.
+static void loopbackDeliver( LoopbackInput *input, unsigned long long time )
+{
+  MidiInApi::RtMidiInData *data = input->rtData;
+  MidiInApi::MidiMessage& message = data->message;
+
+  // Delta time from the send time of the previous message.
+  message.timeStamp = 0.0;
+  if ( data->firstMessage == true )
+    data->firstMessage = false;
+  else
+    message.timeStamp = ( time - input->lastTime ) * 0.000000001;
+  input->lastTime = time;
+  message.absoluteTime = time;
+
+  if ( data->usingCallback ) {
+    RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
+    data->messageTime = message.absoluteTime;
+    callback( message.timeStamp, &message.bytes, data->userData );
+  }
+  else {
+    // As long as we haven't reached our queue size limit, push the
+    // message.  It's swapped in, so a large sysex is not copied again.
+    if ( !data->queue.pushSwap( message ) )
+      std::cerr << "\nMidiInLoopback: message queue limit reached!!\n\n";
+  }
+}
+
+// The sent bytes are parsed like a receiver on a MIDI cable would:
+// running status is expanded, realtime bytes are passed on right away,
+// even from within sysex, and sysex sent in chunks is concatenated
+// unless the user asked for the chunks as they are.
+static void loopbackMidiHandler( LoopbackInput *input )
+{
+  MidiInApi::RtMidiInData *data = input->rtData;
+  MidiInApi::MidiMessage& message = data->message;
+  std::vector<unsigned char> bytes;
+  std::vector<unsigned char> sysex; // Unfinished sysex
+  unsigned char pending[3];         // Unfinished channel or system common message
+  unsigned int pendingSize = 0, expected = 0;
+  unsigned char runningStatus = 0;
+  double deltaTime;
+  unsigned long long time;
+  data->continueSysex = false;
+
+  while ( input->running.load( std::memory_order_relaxed ) ) {
+    if ( !input->queue.pop( &bytes, &deltaTime, &time ) ) {
+
+      // Sleep until a message is pushed.  The timeout only guards
+      // against a stop request racing with the wait.
+      std::unique_lock<std::mutex> lock( input->mutex );
+      input->waiting.store( true, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      if ( input->queue.size() == 0 && input->running.load( std::memory_order_relaxed ) )
+        input->wakeup.wait_for( lock, std::chrono::milliseconds( 10 ) );
+      input->waiting.store( false, std::memory_order_relaxed );
+      continue;
+    }
+
+    size_t i = 0;
+    while ( i < bytes.size() ) {
+      unsigned char byte = bytes[i];
+
+      if ( byte >= 0xF8 ) {
+        // Realtime, doesn't affect running status or sysex.
+        i++;
+        if ( ( byte == 0xF8 || byte == 0xF9 ) && ( data->ignoreFlags & 0x02 ) ) continue;
+        if ( byte == 0xFE && ( data->ignoreFlags & 0x04 ) ) continue;
+        message.bytes.assign( 1, byte );
+        loopbackDeliver( input, time );
+        continue;
+      }
+
+      if ( data->continueSysex ) {
+        // Append data bytes up to the next status byte in one go.
+        size_t end = i;
+        while ( end < bytes.size() && bytes[end] < 0x80 ) end++;
+        sysex.insert( sysex.end(), bytes.begin() + i, bytes.begin() + end );
+        i = end;
+        if ( i == bytes.size() ) break;
+        byte = bytes[i];
+        if ( byte >= 0xF8 ) continue;
+
+        // Any status byte ends the sysex, only an end byte completes it.
+        data->continueSysex = false;
+        if ( byte == 0xF7 ) {
+          i++;
+          sysex.push_back( byte );
+          if ( !( data->ignoreFlags & 0x01 ) ) {
+            message.bytes.swap( sysex );
+            loopbackDeliver( input, time );
+          }
+          sysex.clear();
+          continue;
+        }
+        sysex.clear();
+      }
+
+      i++;
+      if ( byte == 0xF0 ) {
+        sysex.assign( 1, byte );
+        data->continueSysex = true;
+        runningStatus = 0;
+        pendingSize = 0;
+        continue;
+      }
+      if ( byte >= 0x80 ) {
+        // Status byte, system common messages cancel running status.
+        pending[0] = byte;
+        pendingSize = 1;
+        if ( byte < 0xF0 ) {
+          runningStatus = byte;
+          expected = ( ( byte & 0xE0 ) == 0xC0 ) ? 2 : 3;
+        }
+        else {
+          runningStatus = 0;
+          expected = ( byte == 0xF2 ) ? 3 : ( byte == 0xF1 || byte == 0xF3 ) ? 2 : 1;
+        }
+      }
+      else if ( pendingSize > 0 ) {
+        pending[pendingSize++] = byte;
+      }
+      else if ( runningStatus ) {
+        pending[0] = runningStatus;
+        pending[1] = byte;
+        pendingSize = 2;
+        expected = ( ( runningStatus & 0xE0 ) == 0xC0 ) ? 2 : 3;
+      }
+      else {
+        // Stray data byte.
+        continue;
+      }
+
+      if ( pendingSize == expected ) {
+        pendingSize = 0;
+        if ( pending[0] == 0xF1 && ( data->ignoreFlags & 0x02 ) ) continue;
+        message.bytes.assign( pending, pending + expected );
+        loopbackDeliver( input, time );
+      }
+    }
+
+    // Hand on sysex chunks as they are if asked to.
+    if ( data->continueSysex && data->sysexChunking && !sysex.empty() ) {
+      if ( !( data->ignoreFlags & 0x01 ) ) {
+        message.bytes.swap( sysex );
+        loopbackDeliver( input, time );
+      }
+      sysex.clear();
+    }
+  }
+}
+
+MidiInLoopback :: MidiInLoopback( const std::string clientName, unsigned int queueSizeLimit ) : MidiInApi( queueSizeLimit )
+{
+  initialize( clientName );
+}
+
+MidiInLoopback :: ~MidiInLoopback()
+{
+  // Close a connection if it exists.
+  closePort();
+
+  // Cleanup.
+  LoopbackInput *data = static_cast<LoopbackInput *> (apiData_);
+  if ( data->vport ) loopbackRemovePort( data->vport );
+  delete data;
+}
+
+void MidiInLoopback :: initialize( const std::string& /*clientName*/ )
+{
+  LoopbackInput *data = new LoopbackInput;
+  data->rtData = &inputData_;
+  data->queue.allocate( LOOPBACK_QUEUE_SIZE );
+  data->running = false;
+  data->waiting = false;
+  data->lastTime = 0;
+  apiData_ = (void *) data;
+  inputData_.apiData = (void *) data;
+}
+
+unsigned int MidiInLoopback :: getPortCount()
+{
+  return loopbackPortCount();
+}
+
+std::string MidiInLoopback :: getPortName( unsigned int portNumber )
+{
+  std::string name = loopbackPortName( portNumber );
+  if ( name.empty() ) {
+    std::ostringstream ost;
+    ost << "MidiInLoopback::getPortName: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::WARNING, errorString_ );
+  }
+  return name;
+}
+
+void MidiInLoopback :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiInLoopback::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  LoopbackInput *data = static_cast<LoopbackInput *> (apiData_);
+  std::shared_ptr<LoopbackPort> port = loopbackFindPort( portNumber );
+  if ( !port ) {
+    std::ostringstream ost;
+    ost << "MidiInLoopback::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  // Start the input thread before messages can come in.
+  if ( !data->running ) {
+    data->running = true;
+    data->thread = std::thread( loopbackMidiHandler, data );
+  }
+  data->port = port;
+  loopbackConnect( port.get(), data );
+  connected_ = true;
+}
+
+void MidiInLoopback :: openVirtualPort( const std::string portName )
+{
+  LoopbackInput *data = static_cast<LoopbackInput *> (apiData_);
+  if ( !data->vport ) data->vport = loopbackAddPort( portName );
+  if ( !data->running ) {
+    data->running = true;
+    data->thread = std::thread( loopbackMidiHandler, data );
+  }
+
+  // Connect once, even if opened again.
+  loopbackDisconnect( data->vport.get(), data );
+  loopbackConnect( data->vport.get(), data );
+}
+
+void MidiInLoopback :: closePort( void )
+{
+  LoopbackInput *data = static_cast<LoopbackInput *> (apiData_);
+
+  // Disconnect first so no sender waits on the queue once the thread
+  // is gone.
+  if ( connected_ ) {
+    loopbackDisconnect( data->port.get(), data );
+    data->port.reset();
+    connected_ = false;
+  }
+  if ( data->vport ) loopbackDisconnect( data->vport.get(), data );
+
+  // Stop thread to avoid triggering the callback, while the port is intended to be closed
+  if ( data->running ) {
+    {
+      std::lock_guard<std::mutex> lock( data->mutex );
+      data->running = false;
+      data->wakeup.notify_one();
+    }
+    data->thread.join();
+  }
+}
+
+//*********************************************************************//
+//  API: Loopback
+//  Class Definitions: MidiOutLoopback
+//*********************************************************************//
+
+MidiOutLoopback :: MidiOutLoopback( const std::string clientName ) : MidiOutApi()
+{
+  initialize( clientName );
+}
+
+MidiOutLoopback :: ~MidiOutLoopback()
+{
+  // Close a connection if it exists.
+  closePort();
+
+  // Cleanup.
+  LoopbackOutput *data = static_cast<LoopbackOutput *> (apiData_);
+  if ( data->vport ) loopbackRemovePort( data->vport );
+  delete data;
+}
+
+void MidiOutLoopback :: initialize( const std::string& /*clientName*/ )
+{
+  apiData_ = (void *) new LoopbackOutput;
+}
+
+unsigned int MidiOutLoopback :: getPortCount()
+{
+  return loopbackPortCount();
+}
+
+std::string MidiOutLoopback :: getPortName( unsigned int portNumber )
+{
+  std::string name = loopbackPortName( portNumber );
+  if ( name.empty() ) {
+    std::ostringstream ost;
+    ost << "MidiOutLoopback::getPortName: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::WARNING, errorString_ );
+  }
+  return name;
+}
+
+void MidiOutLoopback :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiOutLoopback::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  LoopbackOutput *data = static_cast<LoopbackOutput *> (apiData_);
+  data->port = loopbackFindPort( portNumber );
+  if ( !data->port ) {
+    std::ostringstream ost;
+    ost << "MidiOutLoopback::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+  connected_ = true;
+}
+
+void MidiOutLoopback :: openVirtualPort( const std::string portName )
+{
+  LoopbackOutput *data = static_cast<LoopbackOutput *> (apiData_);
+  if ( !data->vport ) data->vport = loopbackAddPort( portName );
+}
+
+void MidiOutLoopback :: closePort( void )
+{
+  if ( connected_ ) {
+    LoopbackOutput *data = static_cast<LoopbackOutput *> (apiData_);
+    data->port.reset();
+    connected_ = false;
+  }
+}
+
+void MidiOutLoopback :: sendMessage( std::vector<unsigned char> *message )
+{
+  sendBytes( message->data(), message->size() );
+}
+
+void MidiOutLoopback :: sendBytes( const unsigned char *message, size_t size )
+{
+  if ( size == 0 ) {
+    errorString_ = "MidiOutLoopback::sendMessage: no data in message argument!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  // Send to the connected port, like a subscription, and to whoever is
+  // connected to our virtual port.
+  LoopbackOutput *data = static_cast<LoopbackOutput *> (apiData_);
+  LoopbackPort *ports[2] = { data->port.get(), data->vport.get() };
+  for ( LoopbackPort *port : ports ) {
+    if ( !port ) continue;
+    std::lock_guard<std::mutex> lock( port->mutex );
+    for ( LoopbackInput *input : port->inputs )
+      loopbackPush( input, message, size );
+  }
+}
+
+void MidiOutLoopback :: sendMessages( std::vector<unsigned char> *messages, unsigned int count )
+{
+  for ( unsigned int i=0; i<count; ++i ) {
+    if ( messages[i].empty() ) {
+      errorString_ = "MidiOutLoopback::sendMessages: no data in message argument!";
+      error( RtMidiError::WARNING, errorString_ );
+    }
+  }
+
+  // Like sendBytes() but the locks are taken and the input threads are
+  // woken up once per batch instead of once per message, like the single
+  // drain of a batch with ALSA.
+  LoopbackOutput *data = static_cast<LoopbackOutput *> (apiData_);
+  LoopbackPort *ports[2] = { data->port.get(), data->vport.get() };
+  for ( LoopbackPort *port : ports ) {
+    if ( !port ) continue;
+    std::lock_guard<std::mutex> lock( port->mutex );
+    for ( LoopbackInput *input : port->inputs ) {
+      {
+        std::lock_guard<std::mutex> pushLock( input->pushMutex );
+        for ( unsigned int i=0; i<count; ++i ) {
+          if ( messages[i].empty() ) continue;
+          if ( !loopbackQueue( input, messages[i].data(), messages[i].size() ) ) break;
+        }
+      }
+      loopbackWake( input );
+    }
+  }
+}
@@ -45,6 +45,7 @@
 
 #define RTMIDI_VERSION "2.1.1"
 
+#include <atomic>
 #include <exception>
 #include <iostream>
 #include <string>
@@ -67,6 +68,7 @@ class RtMidiError : public std::exception
   enum Type {
     WARNING,           /*!< A non-critical error. */
     DEBUG_WARNING,     /*!< A non-critical error which might be useful for debugging. */
+    BUFFER_FULL,       /*!< The output could not take the message right now, it was not sent and may be retried. */
     UNSPECIFIED,       /*!< The default, unspecified error type. */
     NO_DEVICES_FOUND,  /*!< No devices found on system. */
     INVALID_DEVICE,    /*!< An invalid device ID was specified. */
@@ -124,7 +126,8 @@ class RtMidi
     LINUX_ALSA,     /*!< The Advanced Linux Sound Architecture API. */
     UNIX_JACK,      /*!< The JACK Low-Latency MIDI Server API. */
     WINDOWS_MM,     /*!< The Microsoft Multimedia MIDI API. */
-    RTMIDI_DUMMY    /*!< A compilable but non-functional API. */
+    RTMIDI_DUMMY,   /*!< A compilable but non-functional API. */
+    RTMIDI_LOOPBACK /*!< An in-process loopback API for testing without MIDI hardware. */
   };
 
   //! A static function to determine the current RtMidi version.
@@ -307,6 +310,18 @@ class RtMidiIn : public RtMidi
   */
   void ignoreTypes( bool midiSysex = true, bool midiTime = true, bool midiSense = true );
 
+  //! Specify whether sysex messages should be delivered in the chunks they arrive in.
+  /*!
+    By default, sysex messages which the API delivers in chunks (ALSA
+    splits them into 256 byte events) are reassembled and delivered
+    once complete.  If enabled, each chunk is delivered as soon as it
+    arrives instead: the first chunk starts with 0xF0 and the last one
+    ends with 0xF7, so a large dump can be streamed without holding it
+    in memory.  APIs which only deliver complete messages are not
+    affected.
+  */
+  void setSysexChunking( bool enable = true );
+
   //! Fill the user-provided vector with the data bytes for the next available MIDI message in the input queue and return the event delta-time in seconds.
   /*!
     This function returns immediately whether a new message is
@@ -317,6 +332,33 @@ class RtMidiIn : public RtMidi
   */
   double getMessage( std::vector<unsigned char> *message );
 
+  //! Fill up to \e count user-provided vectors and delta-times with the next available MIDI messages in the input queue and return the number of messages retrieved.
+  /*!
+    This function drains many queued messages in one call and returns
+    immediately, with 0 if no message is available.  \e messages and
+    \e deltaTimes must both point to at least \e count elements, as
+    must \e absoluteTimes if given, which is filled with the messages'
+    absolute times as returned by getMessageTime().  The vectors are
+    reused, so passing the same storage on every call avoids
+    reallocating them.  An exception is thrown if an error occurs
+    during message retrieval or an input connection was not
+    previously established.
+  */
+  unsigned int getMessages( std::vector<unsigned char> *messages, double *deltaTimes, unsigned int count,
+                            unsigned long long *absoluteTimes = 0 );
+
+  //! Return the absolute time of the last message passed to the callback or returned by getMessage() in nanoseconds.
+  /*!
+    Delta times only relate messages on the same port and summing
+    them accumulates rounding errors.  The absolute time is taken
+    from the API's own time stamp where it has one, ie. the ALSA
+    event time, and converted to the std::chrono::steady_clock time
+    base, CLOCK_MONOTONIC on Linux, so times from different ports
+    and from the steady clock can be compared directly.  Call it
+    from within the callback or right after getMessage().
+  */
+  unsigned long long getMessageTime( void );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -408,6 +450,51 @@ class RtMidiOut : public RtMidi
   */
   void sendMessage( std::vector<unsigned char> *message );
 
+  //! Immediately send a single message of \e size bytes out an open MIDI output port.
+  /*!
+      The message is read from the caller's memory, so large sysex
+      dumps do not have to be copied into a vector first.  With ALSA,
+      a complete sysex message is passed to the sequencer as is,
+      without being encoded.  An exception is thrown if an error
+      occurs during output or an output connection was not previously
+      established.
+  */
+  void sendMessage( const unsigned char *message, size_t size );
+
+  //! Immediately send \e count messages out an open MIDI output port as a single batch.
+  /*!
+      With ALSA, the messages are written into the sequencer output
+      buffer and drained with one system call instead of one per
+      message.  The loopback API wakes up its inputs once per batch.
+      The other APIs send them one by one.  A warning is
+      issued for each message which could not be sent.
+  */
+  void sendMessages( std::vector<unsigned char> *messages, unsigned int count );
+
+  //! Set the size of the output buffer in bytes used by sendMessages() (ALSA only).
+  /*!
+      A batch larger than the output buffer is drained whenever the
+      buffer fills up.  The function issues a warning with the other APIs.
+  */
+  void setOutputBufferSize( unsigned int size );
+
+  //! Schedule a message to be sent \e timeStamp seconds after the output queue was started (ALSA only).
+  /*!
+      The message is put on an ALSA sequencer queue which delivers it
+      at the given real time, independent of the calling thread.  The
+      queue is started by the first call to this function or to
+      getQueueTime().  With the other APIs, the message is sent
+      immediately and a warning is issued.
+  */
+  void sendMessageAt( std::vector<unsigned char> *message, double timeStamp );
+
+  //! Return the current time of the output queue in seconds (ALSA only).
+  /*!
+      The queue is started on first use.  With the other APIs, 0.0 is
+      returned and a warning is issued.
+  */
+  double getQueueTime( void );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -473,29 +560,74 @@ class MidiInApi : public MidiApi
   void setCallback( RtMidiIn::RtMidiCallback callback, void *userData );
   void cancelCallback( void );
   virtual void ignoreTypes( bool midiSysex, bool midiTime, bool midiSense );
+  void setSysexChunking( bool enable );
   double getMessage( std::vector<unsigned char> *message );
+  unsigned int getMessages( std::vector<unsigned char> *messages, double *deltaTimes, unsigned int count,
+                            unsigned long long *absoluteTimes );
+  unsigned long long getMessageTime( void ) const { return inputData_.messageTime; }
 
   // A MIDI structure used internally by the class to store incoming
   // messages.  Each message represents one and only one MIDI message.
   struct MidiMessage { 
     std::vector<unsigned char> bytes; 
     double timeStamp;
+    unsigned long long absoluteTime; // steady clock nanoseconds
 
     // Default constructor.
   MidiMessage()
-  :bytes(0), timeStamp(0.0) {}
+  :bytes(0), timeStamp(0.0), absoluteTime(0) {}
   };
 
-  struct MidiQueue {
-    unsigned int front;
-    unsigned int back;
+  // A preallocated MIDI queue slot.  Channel, system common and
+  // realtime messages are stored in the inline bytes while longer
+  // (sysex) messages use the overflow buffer, which only ever grows.
+  // Once the queue has warmed up, pushing and popping do not allocate.
+  // Large messages can also be swapped in and out of the overflow
+  // buffer instead of being copied.
+  struct MidiSlot {
+    enum { INLINE_SIZE = 16 };
+    unsigned char bytes[INLINE_SIZE];
+    std::vector<unsigned char> overflow;
     unsigned int size;
+    double timeStamp;
+    unsigned long long absoluteTime;
+
+    // Default constructor.
+  MidiSlot()
+  :size(0), timeStamp(0.0), absoluteTime(0) {}
+    void assign( const std::vector<unsigned char>& message, double stamp, unsigned long long absolute );
+    void assign( const unsigned char *message, unsigned int messageSize, double stamp, unsigned long long absolute );
+    void swap( std::vector<unsigned char>& message, double stamp, unsigned long long absolute );
+    const unsigned char *data( void ) const { return size > INLINE_SIZE ? &overflow[0] : bytes; }
+  };
+
+  // A lock-free single-producer/single-consumer ring of MIDI messages.
+  // The API input thread or callback is the only producer (push) and
+  // getMessage() is the only consumer (pop).  The producer owns back,
+  // the consumer owns front and each index sits on its own cache line.
+  // One slot is always left empty to tell a full ring from an empty one,
+  // so the ring holds ringSize - 1 messages.
+  struct MidiQueue {
+    std::atomic<unsigned int> front;
+    char frontPad[64 - sizeof(std::atomic<unsigned int>)];
+    std::atomic<unsigned int> back;
+    char backPad[64 - sizeof(std::atomic<unsigned int>)];
     unsigned int ringSize;
-    MidiMessage *ring;
+    MidiSlot *ring;
 
     // Default constructor.
   MidiQueue()
-  :front(0), back(0), size(0), ringSize(0) {}
+  :front(0), back(0), ringSize(0), ring(0) {}
+  ~MidiQueue() { free(); }
+    void allocate( unsigned int size ); // room for size messages, drops any queued
+    void free( void );
+    bool push( const MidiMessage& message );
+    bool push( const std::vector<unsigned char>& bytes, double timeStamp, unsigned long long absoluteTime = 0 );
+    bool push( const unsigned char *bytes, unsigned int size, double timeStamp, unsigned long long absoluteTime = 0 );
+    bool pushSwap( MidiMessage& message ); // leaves message.bytes with unspecified contents
+    bool pop( std::vector<unsigned char> *message, double *timeStamp, unsigned long long *absoluteTime = 0 );
+    bool peek( double *timeStamp, unsigned long long *absoluteTime = 0 ) const; // times of the next message to pop
+    unsigned int size( void ) const;
   };
 
   // The RtMidiInData structure is used to pass private class data to
@@ -511,12 +643,14 @@ class MidiInApi : public MidiApi
     RtMidiIn::RtMidiCallback userCallback;
     void *userData;
     bool continueSysex;
+    bool sysexChunking;
+    unsigned long long messageTime; // absolute time of the last message delivered
 
     // Default constructor.
   RtMidiInData()
   : ignoreFlags(7), doInput(false), firstMessage(true),
       apiData(0), usingCallback(false), userCallback(0), userData(0),
-      continueSysex(false) {}
+      continueSysex(false), sysexChunking(false), messageTime(0) {}
   };
 
  protected:
@@ -530,6 +664,11 @@ class MidiOutApi : public MidiApi
   MidiOutApi( void );
   virtual ~MidiOutApi( void );
   virtual void sendMessage( std::vector<unsigned char> *message ) = 0;
+  virtual void sendBytes( const unsigned char *message, size_t size );
+  virtual void sendMessages( std::vector<unsigned char> *messages, unsigned int count );
+  virtual void setOutputBufferSize( unsigned int size );
+  virtual void sendMessageAt( std::vector<unsigned char> *message, double timeStamp );
+  virtual double getQueueTime( void );
 };
 
 // **************************************************************** //
@@ -548,7 +687,10 @@ inline void RtMidiIn :: cancelCallback( void ) { ((MidiInApi *)rtapi_)->cancelCa
 inline unsigned int RtMidiIn :: getPortCount( void ) { return rtapi_->getPortCount(); }
 inline std::string RtMidiIn :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiIn :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense ) { ((MidiInApi *)rtapi_)->ignoreTypes( midiSysex, midiTime, midiSense ); }
+inline void RtMidiIn :: setSysexChunking( bool enable ) { ((MidiInApi *)rtapi_)->setSysexChunking( enable ); }
 inline double RtMidiIn :: getMessage( std::vector<unsigned char> *message ) { return ((MidiInApi *)rtapi_)->getMessage( message ); }
+inline unsigned int RtMidiIn :: getMessages( std::vector<unsigned char> *messages, double *deltaTimes, unsigned int count, unsigned long long *absoluteTimes ) { return ((MidiInApi *)rtapi_)->getMessages( messages, deltaTimes, count, absoluteTimes ); }
+inline unsigned long long RtMidiIn :: getMessageTime( void ) { return ((MidiInApi *)rtapi_)->getMessageTime(); }
 inline void RtMidiIn :: setErrorCallback( RtMidiErrorCallback errorCallback, void *userData ) { rtapi_->setErrorCallback(errorCallback, userData); }
 
 inline RtMidi::Api RtMidiOut :: getCurrentApi( void ) throw() { return rtapi_->getCurrentApi(); }
@@ -559,6 +701,11 @@ inline bool RtMidiOut :: isPortOpen() const { return rtapi_->isPortOpen(); }
 inline unsigned int RtMidiOut :: getPortCount( void ) { return rtapi_->getPortCount(); }
 inline std::string RtMidiOut :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiOut :: sendMessage( std::vector<unsigned char> *message ) { ((MidiOutApi *)rtapi_)->sendMessage( message ); }
+inline void RtMidiOut :: sendMessage( const unsigned char *message, size_t size ) { ((MidiOutApi *)rtapi_)->sendBytes( message, size ); }
+inline void RtMidiOut :: sendMessages( std::vector<unsigned char> *messages, unsigned int count ) { ((MidiOutApi *)rtapi_)->sendMessages( messages, count ); }
+inline void RtMidiOut :: setOutputBufferSize( unsigned int size ) { ((MidiOutApi *)rtapi_)->setOutputBufferSize( size ); }
+inline void RtMidiOut :: sendMessageAt( std::vector<unsigned char> *message, double timeStamp ) { ((MidiOutApi *)rtapi_)->sendMessageAt( message, timeStamp ); }
+inline double RtMidiOut :: getQueueTime( void ) { return ((MidiOutApi *)rtapi_)->getQueueTime(); }
 inline void RtMidiOut :: setErrorCallback( RtMidiErrorCallback errorCallback, void *userData ) { rtapi_->setErrorCallback(errorCallback, userData); }
 
 // **************************************************************** //
@@ -641,6 +788,7 @@ class MidiOutJack: public MidiOutApi
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
   void sendMessage( std::vector<unsigned char> *message );
+  void sendBytes( const unsigned char *message, size_t size );
 
  protected:
   std::string clientName;
@@ -681,9 +829,16 @@ class MidiOutAlsa: public MidiOutApi
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
   void sendMessage( std::vector<unsigned char> *message );
+  void sendBytes( const unsigned char *message, size_t size );
+  void sendMessages( std::vector<unsigned char> *messages, unsigned int count );
+  void setOutputBufferSize( unsigned int size );
+  void sendMessageAt( std::vector<unsigned char> *message, double timeStamp );
+  double getQueueTime( void );
 
  protected:
   void initialize( const std::string& clientName );
+  bool startQueue( void );
+  bool outputMessage( const unsigned char *bytes, unsigned int nBytes, double timeStamp = -1.0 );
 };
 
 #endif
@@ -760,4 +915,52 @@ class MidiOutDummy: public MidiOutApi
 
 #endif
 
+// The loopback API connects RtMidiIn and RtMidiOut instances within
+// the same process, without any MIDI driver, so tests can be run on a
+// machine without a sound stack.  It is always compiled but only used
+// when asked for with RtMidi::RTMIDI_LOOPBACK.
+//
+// There are always four "Loopback Through" ports, like the ALSA "Midi
+// Through" ports, and virtual ports opened on either side are listed
+// on both sides until they are closed.  Messages sent to a port are
+// pushed to the lock-free queue of each input connected to it and
+// parsed by that input's own thread like bytes received on a MIDI
+// cable, so running status is expanded and realtime bytes within
+// sysex are passed on as separate messages.
+
+class MidiInLoopback: public MidiInApi
+{
+ public:
+  MidiInLoopback( const std::string clientName, unsigned int queueSizeLimit );
+  ~MidiInLoopback( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::RTMIDI_LOOPBACK; }
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+
+ protected:
+  void initialize( const std::string& clientName );
+};
+
+class MidiOutLoopback: public MidiOutApi
+{
+ public:
+  MidiOutLoopback( const std::string clientName );
+  ~MidiOutLoopback( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::RTMIDI_LOOPBACK; }
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void sendMessage( std::vector<unsigned char> *message );
+  void sendBytes( const unsigned char *message, size_t size );
+  void sendMessages( std::vector<unsigned char> *messages, unsigned int count );
+
+ protected:
+  void initialize( const std::string& clientName );
+};
+
 #endif
@@ -0,0 +1,52 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "Scheduler.h"
+
+#include <thread>
+
+Scheduler::Scheduler(std::chrono::nanoseconds interval,
+                     std::chrono::microseconds spin) :
+    interval(interval), spin(spin) {
+    start();
+}
+
+void Scheduler::start() {
+    next = Clock::now();
+    errors.clear();
+}
+
+void Scheduler::wait() {
+    waitUntil(next);
+    next += interval;
+}
+
+void Scheduler::waitUntil(Clock::time_point deadline) {
+
+    // sleep until just before the deadline, then spin the rest
+    if(spin.count() > 0) {
+        std::this_thread::sleep_until(deadline - spin);
+        while(Clock::now() < deadline) {}
+    }
+    else {
+        std::this_thread::sleep_until(deadline);
+    }
+
+    // record error
+    std::chrono::nanoseconds error = Clock::now() - deadline;
+    errors.record(error.count());
+}
@@ -0,0 +1,59 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <chrono>
+#include "Histogram.h"
+
+// absolute deadline scheduler
+//
+// deadlines are computed from a steady clock start time so time spent
+// between waits, ie. printing & sending, and sleep slop do not
+// accumulate as drift over long runs
+//
+// the last spin microseconds before each deadline are busy-waited for
+// sub-millisecond accuracy at the cost of CPU time
+class Scheduler {
+
+    public:
+
+        typedef std::chrono::steady_clock Clock;
+
+        Scheduler(std::chrono::nanoseconds interval,
+                  std::chrono::microseconds spin=std::chrono::microseconds(0));
+
+        // reset stats & set the first deadline to now
+        void start();
+
+        // wait until the next deadline, record the schedule error, and
+        // advance the deadline by the interval
+        void wait();
+
+        // wait until an irregular deadline, ie. from a file's time stamps,
+        // & record the schedule error, leaves the next deadline as is
+        void waitUntil(Clock::time_point deadline);
+
+        // schedule error distribution: wake time - deadline
+        Histogram errors;
+
+    protected:
+
+        std::chrono::nanoseconds interval;
+        std::chrono::microseconds spin;
+        Clock::time_point next; // next deadline
+};
@@ -0,0 +1,36 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// current steady clock time, the same time base as the absolute time
+// stamps of received messages, in seconds or nanoseconds
+
+inline double steadySeconds() {
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now().time_since_epoch();
+    return time.count();
+}
+
+inline uint64_t steadyNanos() {
+    std::chrono::nanoseconds time =
+        std::chrono::steady_clock::now().time_since_epoch();
+    return time.count();
+}
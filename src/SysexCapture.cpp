@@ -0,0 +1,116 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "SysexCapture.h"
+#include "SteadyClock.h"
+
+#include <chrono>
+
+// write once this many bytes are buffered
+#define CAPTURE_BUFFER_SIZE 262144
+
+// or after this many secs when idle
+#define CAPTURE_FLUSH_INTERVAL 0.25
+
+// update a CRC-32 (IEEE 802.3, as used by zip & png) with a block of bytes
+static uint32_t crc32(uint32_t crc, const unsigned char *bytes, size_t size) {
+    static uint32_t table[256] = {0};
+    if(table[1] == 0) {
+        for(uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    for(size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+SysexCapture::SysexCapture(unsigned int queueSize) :
+    completed(0), running(false), droppedCount(0), file(CAPTURE_BUFFER_SIZE) {
+    queue.allocate(queueSize);
+}
+
+SysexCapture::~SysexCapture() {
+    stop();
+}
+
+bool SysexCapture::open(const std::string &path) {
+    return file.open(path);
+}
+
+void SysexCapture::start() {
+    if(running) {return;}
+    running = true;
+    thread = std::thread(&SysexCapture::process, this);
+}
+
+void SysexCapture::stop() {
+    if(!running) {return;}
+    running = false;
+    thread.join();
+    dropped = droppedCount;
+    file.close();
+    writes = file.writes;
+}
+
+bool SysexCapture::capture(const std::vector<unsigned char> &chunk) {
+
+    // sysex starts with F0, continues with data bytes & ends with F7
+    if(chunk.empty() || (chunk[0] != 0xF0 && chunk[0] != 0xF7 && chunk[0] >= 0x80)) {
+        return true;
+    }
+    if(!queue.push(chunk, steadySeconds())) {
+        droppedCount++;
+        return false;
+    }
+    return true;
+}
+
+void SysexCapture::process() {
+    std::vector<unsigned char> chunk;
+    double arrival, lastFlush = steadySeconds();
+    bool stopping = false;
+    while(!stopping) {
+        // check before draining so nothing pushed before stop() is missed
+        stopping = !running;
+        while(queue.pop(&chunk, &arrival)) {
+            if(chunks == 0) {firstTime = arrival;}
+            lastTime = arrival;
+            chunks++;
+            crc = crc32(crc, chunk.data(), chunk.size());
+            bytes += chunk.size();
+            file.write(chunk.data(), chunk.size());
+            if(chunk.back() == 0xF7) {completed++;}
+        }
+
+        // slow dumps still reach the disk every so often
+        if(steadySeconds() - lastFlush >= CAPTURE_FLUSH_INTERVAL) {
+            file.flush();
+            lastFlush = steadySeconds();
+        }
+        if(!stopping) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    file.flush();
+}
@@ -0,0 +1,81 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileWriter.h"
+#include "RtMidi.h"
+
+// streaming sysex capture to a file
+//
+// sysex chunks are handed off from the MIDI input thread through a
+// lock-free queue to a writer thread which appends them to a write
+// buffer & writes it to the file in large blocks, so a dump is never
+// held in memory as a whole & the input thread never waits on the disk
+//
+// non-sysex messages are skipped & a CRC-32 of the written bytes is
+// computed along the way
+class SysexCapture {
+
+    public:
+
+        SysexCapture(unsigned int queueSize=4096);
+        virtual ~SysexCapture();
+
+        // create or truncate the capture file, prints an error & returns
+        // false if it could not be opened
+        bool open(const std::string &path);
+
+        // start the writer thread
+        void start();
+
+        // write the remaining chunks, stop the writer thread & close
+        // the file
+        void stop();
+
+        // queue a sysex message or chunk for writing, returns false if it
+        // was dropped, only call from one thread at a time
+        bool capture(const std::vector<unsigned char> &chunk);
+
+        // complete sysex messages written so far
+        std::atomic<unsigned long> completed;
+
+        // stats, read after stop()
+        unsigned long chunks = 0;   // chunks written
+        unsigned long dropped = 0;  // chunks dropped due to a full queue
+        unsigned long writes = 0;   // write() calls
+        uint64_t bytes = 0;         // bytes written
+        uint32_t crc = 0;           // CRC-32 of the bytes written
+        double firstTime = 0;       // arrival of the first & last chunk,
+        double lastTime = 0;        // steady clock secs
+
+    protected:
+
+        // writer thread loop
+        void process();
+
+        MidiInApi::MidiQueue queue;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<unsigned long> droppedCount;
+        FileWriter file; // only touched by the writer thread while running
+};
@@ -0,0 +1,111 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#include "SysexWriter.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include "Scheduler.h"
+
+constexpr double SysexWriter::WIRE_RATE;
+
+SysexWriter::SysexWriter(RtMidiOut *midiout, size_t chunkSize, double byteRate) :
+    midiout(midiout), chunkSize(std::max(chunkSize, (size_t)1)), byteRate(byteRate) {
+    // CoreMIDI and WinMM reject a message which doesn't start with F0 and
+    // is longer than 3 bytes, so every continuation chunk would fail
+    RtMidi::Api api = midiout->getCurrentApi();
+    chunked = (api == RtMidi::LINUX_ALSA || api == RtMidi::UNIX_JACK ||
+               api == RtMidi::RTMIDI_LOOPBACK);
+}
+
+void SysexWriter::setErrorCallback(RtMidiErrorCallback callback, void *userData) {
+    errorCallback = callback;
+    errorUserData = userData;
+}
+
+bool SysexWriter::write(const unsigned char *data, size_t size, Progress progress) {
+    written = 0;
+    chunks = 0;
+    stalls = 0;
+    elapsed = 0;
+    sendFailed = false;
+    size_t step = (chunked ? chunkSize : std::max(size, (size_t)1));
+
+    // time one chunk takes on the wire, used as retry backoff
+    std::chrono::nanoseconds chunkTime(byteRate > 0 ?
+        (long long)(step / byteRate * 1000000000.0) : 1000000);
+
+    midiout->setErrorCallback(sendError, this);
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    bool ok = true;
+    while(written < size) {
+
+        // pace by absolute deadline: chunk n is due when the bytes before
+        // it would have left at the byte rate
+        if(byteRate > 0) {
+            std::this_thread::sleep_until(start +
+                std::chrono::nanoseconds((long long)(written / byteRate * 1000000000.0)));
+        }
+
+        size_t length = std::min(step, size - written);
+        unsigned int retries = 0;
+        while(true) {
+            unsigned long full = bufferFull;
+            midiout->sendMessage(data + written, length);
+            if(sendFailed) {
+                ok = false;
+                break;
+            }
+            if(bufferFull == full) {break;}
+            if(++retries > maxRetries) {
+                ok = false;
+                break;
+            }
+            stalls++;
+            std::this_thread::sleep_for(chunkTime);
+        }
+        if(!ok) {break;}
+        written += length;
+        chunks++;
+        if(progress && !progress(written, size)) {
+            ok = false;
+            break;
+        }
+    }
+    std::chrono::duration<double> time = Scheduler::Clock::now() - start;
+    elapsed = time.count();
+    midiout->setErrorCallback(errorCallback, errorUserData);
+    return ok;
+}
+
+void SysexWriter::sendError(RtMidiError::Type type, const std::string &errorText, void *userData) {
+    SysexWriter *writer = (SysexWriter *)userData;
+    if(type == RtMidiError::BUFFER_FULL) {
+        writer->bufferFull++;
+        return;
+    }
+    if(type == RtMidiError::WARNING || type == RtMidiError::DEBUG_WARNING) {
+        writer->sendFailed = true;
+    }
+    if(writer->errorCallback) {
+        writer->errorCallback(type, errorText, writer->errorUserData);
+    }
+    else {
+        std::cerr << errorText << std::endl;
+    }
+}
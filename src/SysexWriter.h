@@ -0,0 +1,87 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include "RtMidi.h"
+
+// streaming sysex writer
+//
+// splits a large sysex message into chunks which are sent as partial
+// sysex messages, paced to a target byte rate so downstream buffers,
+// ie. a hardware interface running at MIDI wire speed or the JACK
+// output ringbuffer, are not overrun
+//
+// a chunk the output could not take, reported as a BUFFER_FULL error by
+// ALSA or JACK, is retried after waiting a chunk's worth of time:
+// back-pressure slows the writer down instead of silently dropping data,
+// any other send warning fails the write at once
+//
+// chunked pacing only works on ALSA, JACK, and the loopback API, the
+// others can't take partial sysex so the message is sent in one piece
+class SysexWriter {
+
+    public:
+
+        // MIDI 1.0 runs at 31250 baud with 10 bits per byte
+        static constexpr double WIRE_RATE = 3125;
+
+        // called after each chunk, return false to abort writing
+        typedef std::function<bool(size_t written, size_t total)> Progress;
+
+        // byteRate of 0 sends chunks back to back
+        SysexWriter(RtMidiOut *midiout, size_t chunkSize=256,
+                    double byteRate=WIRE_RATE);
+
+        // the error callback restored after writing, the writer sets its
+        // own to catch send warnings
+        void setErrorCallback(RtMidiErrorCallback callback, void *userData=nullptr);
+
+        // send a complete sysex message in chunks, blocks until it was
+        // sent, returns false if a chunk still could not be sent after
+        // maxRetries, on any other send warning, or if writing was aborted
+        // by the progress callback
+        bool write(const unsigned char *data, size_t size, Progress progress=nullptr);
+
+        // can the output API take partial sysex? if not, write() sends
+        // the whole message at once
+        bool isChunked() const {return chunked;}
+
+        // stats for the last write
+        size_t written = 0;       // bytes sent
+        unsigned long chunks = 0; // chunks sent
+        unsigned long stalls = 0; // chunk retries due to back-pressure
+        double elapsed = 0;       // secs
+
+        unsigned int maxRetries = 100; // retries per chunk
+
+    protected:
+
+        // counts back-pressure and records send failures
+        static void sendError(RtMidiError::Type type, const std::string &errorText, void *userData);
+
+        RtMidiOut *midiout;
+        size_t chunkSize;
+        double byteRate;
+        bool chunked;
+        RtMidiErrorCallback errorCallback = nullptr;
+        void *errorUserData = nullptr;
+        unsigned long bufferFull = 0; // BUFFER_FULL errors
+        bool sendFailed = false;      // any other send warning
+};
@@ -17,40 +17,31 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
 #include <chrono>
+#include <ctime>
 #include <thread>
 #include <signal.h>
 #include "RtMidi.h"
-
-// channel voice message     dec value, # data bytes
-#define MIDI_NOTEOFF        0x80 // 128, 2
-#define MIDI_NOTEON         0x90 // 144, 2
-#define MIDI_POLYAFTERTOUCH 0xA0 // 160, 2, aka key pressure
-#define MIDI_CONTROLCHANGE  0xB0 // 176, 2
-#define MIDI_PROGRAMCHANGE  0xC0 // 192, 1
-#define MIDI_AFTERTOUCH     0xD0 // 208, 1, aka channel pressure
-#define MIDI_PITCHBEND      0xE0 // 224, 2
-
-// system common message
-#define MIDI_SYSEX          0xF0 // 240, variable, until MIDI_SYSEXEND
-#define MIDI_TIMECODE       0xF1 // 241, 1
-#define MIDI_SONGPOS        0xF2 // 242, 2
-#define MIDI_SONGSELECT     0xF3 // 243, 1
-//      MIDI_RESERVED1      0xF4 // 244, ?
-//      MIDI_RESERVED2      0xF5 // 245, ?
-#define MIDI_TUNEREQUEST    0xF6 // 246, 0
-#define MIDI_SYSEXEND       0xF7 // 247, 0
- 
-// realtime message
-#define MIDI_CLOCK          0xF8 // 248, 0
-//      MIDI_RESERVED3      0xF9 // 249, ?
-#define MIDI_START          0xFA // 250, 0
-#define MIDI_CONTINUE       0xFB // 251, 0
-#define MIDI_STOP           0xFC // 252, 0
-//      MIDI_RESERVED4      0xFD // 253, 0
-#define MIDI_ACTIVESENSING  0xFE // 254, 0
-#define MIDI_SYSTEMRESET    0xFF // 255, 0
+#include "Capture.h"
+#include "Format.h"
+#include "Histogram.h"
+#include "MappedFile.h"
+#include "MidiFile.h"
+#include "Printer.h"
+#include "Scheduler.h"
+#include "SteadyClock.h"
+#include "SysexCapture.h"
+#include "SysexWriter.h"
 
 static const char* HELP =
 "Usage: miditester [OPTIONS] [TEST]\n"                      \
@@ -58,17 +49,80 @@ static const char* HELP =
 "  a utility program which sends and receives MIDI bytes\n" \
 "\n"                                                        \
 "Options:\n\n"                                              \
-"  -p,--port    MIDI port to use 0-n, default 0\n"          \
+"  -p,--port    MIDI port to use 0-n, default 0, or for\n"  \
+"               input & output tests a list of ports,\n"    \
+"               ranges, or name parts to merge or send\n"   \
+"               to in parallel, ie. 0-3,5 or \"USB\"\n"     \
+"  -i,--inport  MIDI input port for latency, default 0,\n"  \
+"               or to measure output arrival jitter\n"      \
+"  --virtual    Latency or sysex-bulk loopback through a\n" \
+"               virtual port\n"                             \
+"  --loopback   Use in-process loopback ports instead of\n" \
+"               MIDI devices, port 0 sends to inport 0\n"   \
 "  -c,--chan    MIDI channel to send to 1-16, default 1\n"  \
-"  -s,--speed   Millis between messages,\n"                 \
-"               defaults: input 40, output 500\n"           \
+"  -s,--speed   Millis between messages, or micros with\n"  \
+"               a us suffix, ie. 250us,\n"                  \
+"               defaults: input 0, output 500\n"            \
+"               input 0 prints messages as they arrive\n"   \
+"  --spin       Micros to busy-wait before each send\n"     \
+"               deadline for sub-millisecond accuracy,\n"   \
+"               default 0\n"                                \
+"  --schedule   Pre-schedule output on the driver queue\n"  \
+"               instead of sleeping, ALSA only\n"           \
+"  --verify     Compare output tests received on inport,\n" \
+"               default 0, exits with 2 if any failed\n"    \
+"  -b,--burst   Send output tests repeatedly & without\n"   \
+"               printing for throughput testing\n"          \
+"  -r,--rate    Burst messages per sec, default 0: max\n"   \
+"  --batch      Burst messages per send call, default 1\n"  \
+"  --count      Burst message count, default 0: no limit\n" \
+"               or latency probe count, default 1000\n"     \
+"               or capture-sysex message count\n"           \
+"  --duration   Burst secs, default 10, 0: no limit\n"      \
+"  --file       File to read or write for file tests\n"     \
+"  --capture    Write input messages to a binary capture\n" \
+"               file for replay\n"                          \
+"  --record     Write input messages to a type 0 MIDI\n"    \
+"               file\n"                                     \
+"  --ppq        MIDI file ticks per quarter note at 120\n"  \
+"               bpm, default 480\n"                         \
+"  --size       Sysex bytes to generate for sysex-bulk,\n"  \
+"               default 1048576, or to send in chunks\n"    \
+"               after the sysex test, default 0: none\n"    \
+"  --chunk      Sysex chunk bytes, chunking & pacing on\n"  \
+"               ALSA, JACK & loopback only, default 256\n"  \
+"  --byte-rate  Sysex chunk bytes per sec, default 3125:\n" \
+"               MIDI wire speed, or 0 for sysex-bulk\n"     \
+"               --virtual, 0: no pacing\n"                  \
+"  --histogram  Write timing histograms to a CSV file,\n"   \
+"               or JSON with a .json extension\n"           \
+"  -f,--flush-interval\n"                                   \
+"               Max millis between input prints,\n"         \
+"               default 10\n"                               \
 "  -d,--decimal Print decimal byte values instead of hex\n" \
 "  -n,--name    Print status byte name instead of value\n"  \
+"  --timestamps Print input times in secs, abs: steady\n"   \
+"               clock time, comparable across ports,\n"     \
+"               or delta: since the previous message\n"     \
 "  -l,--list    List available MIDI ports and exit\n"       \
 "  -h,--help    This help print\n"                          \
 "\n"                                                        \
 "TEST:\n\n"                                                 \
 "  input    Listen & print MIDI messages\n\n"               \
+"  capture-sysex\n"                                         \
+"           Stream received sysex chunks to --file\n"       \
+"           until --count messages, default 0: stop\n"      \
+"           with Ctrl+C\n\n"                                \
+"  replay   Resend a --file capture with the original\n"    \
+"           timing, or back to back with --burst\n\n"       \
+"  play     Play a type 0 or 1 MIDI file, ie. play\n"       \
+"           file.mid, & report timing error\n\n"            \
+"  latency  Send sysex probes & measure round trip time\n"  \
+"           to input port, default speed 10\n\n"            \
+"  sysex-bulk\n"                                            \
+"           Stream a .syx --file or --size bytes of\n"      \
+"           generated sysex & measure bytes per sec,\n"     \
+"           with --virtual in --chunk pieces & back\n\n"    \
 "  all      Run all output tests below, default\n\n"        \
 "  channel  Channel messages  80 - E0\n"                    \
 "  system   System messages   F0 - F7\n"                    \
@@ -91,6 +145,33 @@ bool isnumeric(const std::string &s) {
   return s.find_first_not_of("0123456789") == std::string::npos;
 }
 
+// parse a time in millis, or micros with a "us" suffix, into micros,
+// returns false if the string is not a valid time
+bool parseMicros(const std::string &s, long &micros) {
+    size_t end = s.find_first_not_of("0123456789");
+    if(end == 0 || s.empty()) {return false;}
+    long value = std::atol(s.substr(0, end).c_str());
+    std::string unit = (end == std::string::npos ? "" : s.substr(end));
+    if(unit == "" || unit == "ms") {
+        micros = value * 1000;
+    }
+    else if(unit == "us") {
+        micros = value;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// format micros as a human readable millis or micros string
+std::string formatMicros(long micros) {
+    if(micros % 1000 == 0) {
+        return std::to_string(micros / 1000) + " ms";
+    }
+    return std::to_string(micros) + " us";
+}
+
 // add all message types to the queue
 void channelMessages(TestQueue &queue, int channel=0);
 void systemMessages(TestQueue &queue, int channel=0);
@@ -104,8 +185,243 @@ void timecode(TestQueue &queue);
 // print midi byte message to the console
 void printMessage(std::vector<unsigned char> &message, bool hex, bool name);
 
-// get string name for status byte
-std::string statusByteName(unsigned char status);
+// input message times to print
+enum Timestamps {
+    TIMESTAMPS_NONE,
+    TIMESTAMPS_ABS,  // absolute steady clock time from the driver
+    TIMESTAMPS_DELTA // driver delta time since the previous message
+};
+
+// input messages printed with a time are framed with the time in nanos
+// as 8 bytes in front, little endian, merged input messages also with
+// the source port number as 2 bytes before that
+#define TIME_HEADER_SIZE 8
+#define SOURCE_HEADER_SIZE (2 + TIME_HEADER_SIZE)
+
+// append a time in nanos to a framed message
+void frameNanos(std::vector<unsigned char> &framed, uint64_t nanos);
+
+// append a framed input message as a line of text to a buffer, tagged
+// with its time in secs
+void formatTimedMessage(const ByteTable &table,
+                        const std::vector<unsigned char> &message,
+                        std::string &buffer);
+
+// append a framed merged input message as a line of text to a buffer,
+// tagged with its port & time in secs
+void formatSourceMessage(const ByteTable &table,
+                         const std::vector<unsigned char> &message,
+                         std::string &buffer);
+
+// input test state shared with the RtMidi input callback
+struct InputContext {
+    RtMidiIn *midiin;
+    Printer *printer;
+    Capture::Writer capture; // written if open
+    MidiFileWriter record;   // written if open
+    Timestamps timestamps = TIMESTAMPS_NONE;
+    uint64_t startTime = 0;  // absolute nanos of the first message
+    Histogram deltaTimes;    // recorded on the input thread
+    std::vector<unsigned char> framed; // message with its time to print
+};
+
+// record, capture & print a received message, nanos is its absolute time
+void inputMessage(InputContext &context, double deltatime, uint64_t nanos,
+                  const std::vector<unsigned char> &message);
+
+// named histograms to write with --histogram
+typedef std::vector<std::pair<std::string, const Histogram*>> HistogramList;
+
+// print histogram summary stats in micros
+void printHistogram(const std::string &label, const Histogram &histogram);
+
+// write histograms to a CSV file or a JSON file if the path ends with
+// .json, returns false on error
+bool writeHistograms(const std::string &path, const HistogramList &histograms);
+
+// RtMidi input callback, hands messages to the Printer as they arrive
+void midiInput(double deltatime, std::vector<unsigned char> *message, void *userData);
+
+// resend the messages in a capture through an output with their original
+// timing, or back to back if burst is set, & print timing stats
+void replayCapture(RtMidiOut *midiout, Capture::Reader &reader, bool burst,
+                   std::chrono::microseconds spin, Histogram &scheduleErrors);
+
+// merged input monitor state for one port, shared with the RtMidi input
+// callback which queues messages with their absolute driver times
+struct MergeSource {
+    unsigned int port = 0;
+    RtMidiIn *midiin = nullptr;
+    MidiInApi::MidiQueue queue; // single producer: the port's input thread
+    unsigned long received = 0;
+    unsigned long dropped = 0;  // due to a full queue
+};
+
+// RtMidi input callback, stamps a message & queues it for merging
+void midiMergeInput(double deltatime, std::vector<unsigned char> *message, void *userData);
+
+// listen on several input ports at once & print their messages merged
+// in time order, tagged with the port, from a single poll loop which
+// merges the per port queues every speed micros, default 1 ms, times
+// are printed since the start unless absolute or delta times are given
+void mergeInputs(RtMidi::Api api, const std::vector<unsigned int> &ports,
+                 long speed, int flushInterval, bool hex, bool name,
+                 Timestamps timestamps);
+
+// RtMidi input callback, hands sysex chunks to the SysexCapture as they arrive
+void midiCaptureInput(double deltatime, std::vector<unsigned char> *message, void *userData);
+
+// send test messages repeatedly without printing, back to back or at
+// rate messages per second, until count messages were sent or duration
+// seconds have passed, then print throughput stats
+//
+// messages are sent batch at a time with a single sendMessages() call
+void sendBurst(RtMidiOut *midiout, TestQueue &queue, long rate,
+               unsigned int batch, unsigned long count, unsigned long duration,
+               Histogram &sendTimes, Histogram &scheduleErrors);
+
+// the send loop of sendBurst() & sendPortTest(): repeat the message list
+// a batch at a time until count messages were sent or duration seconds
+// have passed, sets sent & bytes, returns the number of send calls
+unsigned long sendBurstLoop(RtMidiOut *midiout, MessageQueue messages, long rate,
+                            unsigned int batch, unsigned long count,
+                            unsigned long duration, unsigned long &sent,
+                            unsigned long &bytes, Histogram &sendTimes,
+                            Histogram &scheduleErrors);
+
+// pre-schedule test messages speed micros apart on the output queue so
+// they are delivered by the driver instead of after a userspace sleep,
+// messages are scheduled at most a second ahead to stay within the
+// driver's event pool & the function returns once the last was sent
+void sendScheduled(RtMidiOut *midiout, TestQueue &queue, long speed,
+                   bool hex, bool name, Histogram &sendTimes);
+
+// play a MIDI file through an output at the file's tempo, sleeping until
+// just before each event's deadline, then spinning, or back to back if
+// burst is set, & print timing error versus the file's schedule
+void playMidiFile(RtMidiOut *midiout, MidiFileReader &reader, bool burst,
+                  std::chrono::microseconds spin, Histogram &scheduleErrors);
+
+// output arrival jitter state shared with the RtMidi input callback
+struct ArrivalJitter {
+    double interval;  // expected secs between arrivals
+    Histogram jitter; // |arrival interval - expected interval|
+    unsigned long received = 0;
+};
+
+// RtMidi input callback which records output arrival jitter
+void midiJitterInput(double deltatime, std::vector<unsigned char> *message, void *userData);
+
+// select ports from a comma separated list of port numbers, ranges,
+// ie. 0-3, and name parts matching all ports whose names contain them,
+// prints an error & returns false if an item doesn't match any port
+bool selectPorts(RtMidi *midi, const std::string &list, std::vector<unsigned int> &ports);
+
+// output test state & stats for one of several ports
+struct PortTest {
+    unsigned int port = 0;
+    std::string name;
+    RtMidiOut *midiout = nullptr;
+    Histogram sendTimes;
+    Histogram scheduleErrors;
+    unsigned long sent = 0;
+    unsigned long bytes = 0;
+    unsigned long dropped = 0; // send warnings
+    double elapsed = 0;
+};
+
+// send the test messages to each port on its own thread, speed micros
+// apart or as a burst like sendBurst(), then print stats per port
+void sendParallel(RtMidi::Api api, std::vector<PortTest> &portTests, TestQueue &queue,
+                  long speed, long spin, bool burst, long rate, unsigned int batch,
+                  unsigned long count, unsigned long duration);
+
+// send thread for one port of sendParallel()
+void sendPortTest(PortTest &portTest, const MessageQueue &messages, long speed,
+                  long spin, bool burst, long rate, unsigned int batch,
+                  unsigned long count, unsigned long duration);
+
+// received messages shared with the RtMidi verify input callback
+struct VerifyInput {
+    std::mutex mutex;
+    MessageQueue received;
+};
+
+// RtMidi input callback which collects messages to verify
+void midiVerifyInput(double deltatime, std::vector<unsigned char> *message, void *userData);
+
+// send each test speed micros apart & compare what comes back on the
+// input, returns the number of failed tests
+unsigned int verifyTests(RtMidiOut *midiout, TestQueue &queue, VerifyInput &input,
+                         long speed, long spin, bool hex, bool name);
+
+// what a receiver should get for a sequence of sent messages: running
+// status expanded & realtime bytes within sysex as separate messages
+// in front of the sysex
+void expectedMessages(const MessageQueue &sent, MessageQueue &expected);
+
+// compare received messages against the expected ones & print drops,
+// unexpected messages & reorderings, returns true if they match
+bool verifyMessages(const std::string &label, const MessageQueue &expected,
+                    const MessageQueue &received, bool hex, bool name);
+
+// send all complete sysex messages found in a block of memory, ie. a
+// memory mapped .syx file, straight from that memory as fast as the
+// driver accepts them, then print throughput stats
+void sendSysexBulk(RtMidiOut *midiout, const unsigned char *data, size_t size,
+                   Histogram &sendTimes);
+
+// generate size bytes of test sysex messages of up to messageSize bytes each
+void generateSysex(std::vector<unsigned char> &data, size_t size,
+                   size_t messageSize=4096);
+
+// find the next complete sysex message in a block of memory starting at
+// pos, skipping anything else, returns false if there is none
+bool nextSysex(const unsigned char *data, size_t size, size_t &pos,
+               const unsigned char *&message, size_t &length);
+
+// send sysex messages in chunks through a virtual port loopback, receive
+// them back reassembled from the input queue & print throughput stats
+void sysexLoopbackTest(RtMidiIn *midiin, RtMidiOut *midiout,
+                       const unsigned char *data, size_t size,
+                       size_t chunk, double byteRate);
+
+// send a single generated sysex message of size bytes in chunks paced
+// to byteRate & print progress and stats
+void sendLargeSysex(RtMidiOut *midiout, size_t size, size_t chunk, double byteRate);
+
+// round trip latency test probe state shared with the RtMidi input
+// callback, probes are indexed by sequence number
+struct LatencyProbes {
+    std::vector<std::atomic<long long>> sent; // steady clock send nanos
+    std::vector<double> roundTrips;           // secs, < 0 if not received
+    std::atomic<unsigned long> received;
+    unsigned long duplicates = 0; // probes received more than once
+    unsigned long other = 0;      // non-probe messages
+    LatencyProbes(unsigned long count) : sent(count), roundTrips(count, -1) {
+        for(auto &time : sent) {time = 0;}
+        received = 0;
+    }
+};
+
+// send count sysex probes, interval micros apart, & match their echoes
+// received by the latency input callback, then print round trip stats
+void latencyTest(RtMidiIn *midiin, RtMidiOut *midiout,
+                 LatencyProbes &probes, long interval, Histogram &roundTrips);
+
+// RtMidi input callback which matches probe echoes
+void midiLatencyInput(double deltatime, std::vector<unsigned char> *message, void *userData);
+
+// returns index of the first port whose name contains a string or -1
+int findPort(RtMidi *midi, const std::string &name);
+
+// create an output with a virtual port on a dedicated client which is
+// easy to find by name & open the input on it, returns nullptr if the
+// virtual port loopback is not available
+RtMidiOut* openLoopback(RtMidiIn *midiin, const std::string &name);
+
+// RtMidi error callback which counts warnings, ie. dropped sends
+void midiBurstError(RtMidiError::Type type, const std::string &errorText, void *userData);
 
 // RtMidi error callback
 void midiError(RtMidiError::Type type, const std::string &errorText, void *userData);
@@ -118,18 +434,36 @@ int run = true;
 
 // actual program
 int main(int argc, char *argv[]) {
-    RtMidiIn *midiin = new RtMidiIn();
-    RtMidiOut *midiout = new RtMidiOut();
-    midiin->setErrorCallback(midiError);
-    midiout->setErrorCallback(midiError);
-
     // parse commandline
     std::string tests = "all";
     int port = 0;
+    std::string portList = "0";
+    int inport = -1;
+    bool virtualPort = false;
+    bool loopback = false;
     int channel = 1;
-    int speed = -1;
+    long speed = -1; // micros
+    int spin = 0;
+    bool burst = false;
+    bool schedule = false;
+    bool verify = false;
+    long rate = 0;
+    unsigned int batch = 1;
+    unsigned long count = 0;
+    unsigned long duration = 10;
+    std::string histogramPath = "";
+    std::string filePath = "";
+    std::string capturePath = "";
+    std::string recordPath = "";
+    unsigned int ppq = 480;
+    unsigned long size = 0;
+    unsigned long chunk = 256;
+    long byteRate = -1; // bytes per sec, default depends on the test
+    HistogramList histograms;
+    int flushInterval = 10;
     bool hex = true;
     bool name = false;
+    Timestamps timestamps = TIMESTAMPS_NONE;
     bool list = false;
     std::string option = "";
     for(int i = 1; i < argc; ++i) {
@@ -141,13 +475,64 @@ int main(int argc, char *argv[]) {
                 std::cout << option << " expects a value" << std::endl;
                 return 1;
             }
+            if(option == "-s" || option == "--speed") {
+                if(!parseMicros(arg, speed)) {
+                    std::cout << option << " expects a positive integer "
+                              << "with an optional ms or us suffix, got "
+                              << arg << std::endl;
+                    return 1;
+                }
+                option = "";
+                continue;
+            }
+            if(option == "--histogram") {
+                histogramPath = arg;
+                option = "";
+                continue;
+            }
+            if(option == "--file") {
+                filePath = arg;
+                option = "";
+                continue;
+            }
+            if(option == "--capture") {
+                capturePath = arg;
+                option = "";
+                continue;
+            }
+            if(option == "--record") {
+                recordPath = arg;
+                option = "";
+                continue;
+            }
+            if(option == "--timestamps") {
+                if(arg == "abs") {
+                    timestamps = TIMESTAMPS_ABS;
+                }
+                else if(arg == "delta") {
+                    timestamps = TIMESTAMPS_DELTA;
+                }
+                else {
+                    std::cout << option << " expects abs or delta, got "
+                              << arg << std::endl;
+                    return 1;
+                }
+                option = "";
+                continue;
+            }
+            if(option == "-p" || option == "--port") {
+                portList = arg;
+                if(isnumeric(arg)) {port = std::atoi(argv[i]);}
+                option = "";
+                continue;
+            }
             if(!isnumeric(arg)) {
                 std::cout << option << " expects a positive integer, got "
                           << arg << std::endl;
                 return 1;
             }
-            if(option == "-p" || option == "--port") {
-                port = std::atoi(argv[i]);
+            if(option == "-i" || option == "--inport") {
+                inport = std::atoi(argv[i]);
             }
             else if(option == "-c" || option == "--channel") {
                 channel = std::atoi(argv[i]);
@@ -156,8 +541,39 @@ int main(int argc, char *argv[]) {
                     return 1;
                 }
             }
-            else if(option == "-s" || option == "--speed") {
-                speed = std::atoi(argv[i]);
+            else if(option == "--spin") {
+                spin = std::atoi(argv[i]);
+            }
+            else if(option == "-r" || option == "--rate") {
+                rate = std::atol(argv[i]);
+            }
+            else if(option == "--batch") {
+                batch = std::max(std::atoi(argv[i]), 1);
+            }
+            else if(option == "--count") {
+                count = std::atol(argv[i]);
+            }
+            else if(option == "--size") {
+                size = std::atol(argv[i]);
+            }
+            else if(option == "--ppq") {
+                ppq = std::atoi(argv[i]);
+                if(ppq < 1 || ppq > 0x7FFF) {
+                    std::cout << option << " option must be 1-32767" << std::endl;
+                    return 1;
+                }
+            }
+            else if(option == "--chunk") {
+                chunk = std::max(std::atol(argv[i]), 1L);
+            }
+            else if(option == "--byte-rate") {
+                byteRate = std::atol(argv[i]);
+            }
+            else if(option == "--duration") {
+                duration = std::atol(argv[i]);
+            }
+            else if(option == "-f" || option == "--flush-interval") {
+                flushInterval = std::atoi(argv[i]);
             }
             else {
                 std::cout << "unknown option: " << option << std::endl;
@@ -180,6 +596,21 @@ int main(int argc, char *argv[]) {
             else if(arg == "-n" || arg == "--name") {
                 name = true;
             }
+            else if(arg == "-b" || arg == "--burst") {
+                burst = true;
+            }
+            else if(arg == "--schedule") {
+                schedule = true;
+            }
+            else if(arg == "--verify") {
+                verify = true;
+            }
+            else if(arg == "--virtual") {
+                virtualPort = true;
+            }
+            else if(arg == "--loopback") {
+                loopback = true;
+            }
             else if(arg == "-l" || arg == "--list") {
                 list = true;
                 break;
@@ -188,12 +619,32 @@ int main(int argc, char *argv[]) {
                 option = arg;
             }
         }
+        else if(tests == "play" && filePath == "") {
+            // play file.mid
+            filePath = arg;
+        }
         else {
             // argument
             tests = arg;
         }      
     }
 
+    // only the input & output tests can use several ports
+    bool portListTest = (tests != "capture-sysex" &&
+                         tests != "replay" && tests != "play" &&
+                         tests != "latency" && tests != "sysex-bulk");
+    if(!isnumeric(portList) && !portListTest) {
+        std::cout << tests << " needs a single port number" << std::endl;
+        return 1;
+    }
+
+    // use in-process loopback ports to test without MIDI devices?
+    RtMidi::Api api = loopback ? RtMidi::RTMIDI_LOOPBACK : RtMidi::UNSPECIFIED;
+    RtMidiIn *midiin = new RtMidiIn(api);
+    RtMidiOut *midiout = new RtMidiOut(api);
+    midiin->setErrorCallback(midiError);
+    midiout->setErrorCallback(midiError);
+
     // list devices and exit?
     if(list) {
         if(midiin->getPortCount() > 0) {
@@ -227,11 +678,16 @@ int main(int argc, char *argv[]) {
     signal(SIGINT,  signalExit); // interrupt
 
     if(tests == "input") {
-        if(speed < 0) speed = 40;
+        if(speed < 0) speed = 0;
 
         std::cout << "running tests: " << tests << std::endl
-          << "port: " << port << std::endl
-          << "speed: " << speed << " ms" << std::endl;
+          << "port: " << portList << std::endl;
+        if(speed > 0) {
+            std::cout << "speed: " << formatMicros(speed) << std::endl;
+        }
+        else {
+            std::cout << "speed: event driven" << std::endl;
+        }
 
         // check if there is anything to receive from
         unsigned int numPorts = midiin->getPortCount();
@@ -242,6 +698,70 @@ int main(int argc, char *argv[]) {
             return 0;
         }
 
+        // one port or several?
+        std::vector<unsigned int> ports;
+        if(!selectPorts(midiin, portList, ports)) {
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+        if(ports.size() > 1) {
+            if(capturePath != "" || recordPath != "") {
+                std::cout << "--capture & --record need a single port" << std::endl;
+                delete midiin;
+                delete midiout;
+                return 1;
+            }
+            mergeInputs(midiin->getCurrentApi(), ports, speed, flushInterval,
+                        hex, name, timestamps);
+            delete midiin;
+            delete midiout;
+            return 0;
+        }
+        port = ports[0];
+
+        // messages are printed on a separate thread, flushing the
+        // console output in batches so printing doesn't hold up input
+        const ByteTable &table = byteTable(hex, name);
+        Printer printer([&table, timestamps](std::string &buffer,
+                                             const std::vector<unsigned char> &message) {
+            if(timestamps != TIMESTAMPS_NONE) {
+                formatTimedMessage(table, message, buffer);
+            }
+            else {
+                formatMessage(table, message, buffer);
+            }
+        });
+        printer.start(std::chrono::milliseconds(flushInterval));
+
+        // without a speed, hand messages to the printer from the input
+        // callback as they arrive, otherwise poll the input queue every
+        // speed micros
+        unsigned long pollWakeups = 0;
+        InputContext context;
+        context.midiin = midiin;
+        context.printer = &printer;
+        context.timestamps = timestamps;
+        if(capturePath != "") {
+            if(!context.capture.open(capturePath)) {
+                delete midiin;
+                delete midiout;
+                return 1;
+            }
+            std::cout << "capture: " << capturePath << std::endl;
+        }
+        if(recordPath != "") {
+            if(!context.record.open(recordPath, ppq)) {
+                delete midiin;
+                delete midiout;
+                return 1;
+            }
+            std::cout << "record: " << recordPath << ", " << ppq << " ppq" << std::endl;
+        }
+        if(speed == 0) {
+            midiin->setCallback(midiInput, &context);
+        }
+
         // try opening given port
         midiin->openPort(port);
         std::cout << "opened " << midiin->getPortName(port) << std::endl;
@@ -252,28 +772,367 @@ int main(int argc, char *argv[]) {
         // listen for new messages until loop is stopped
         std::cout << "input test" << std::endl;
         std::cout << "started listening" << std::endl;
-        std::chrono::milliseconds sleepMS(20);
-        std::vector<unsigned char> message;
-        while(run) {
-            if(midiin->getMessage(&message)) {
-                printMessage(message, hex, name);
-                message.clear();
+        auto startTime = std::chrono::steady_clock::now();
+        if(speed == 0) {
+            // the callback does the work, just wait for a signal
+            std::chrono::milliseconds sleepMS(100);
+            while(run) {
+                std::this_thread::sleep_for(sleepMS);
             }
-            std::this_thread::sleep_for(sleepMS);
         }
+        else {
+            std::chrono::microseconds sleepUS(speed);
+            std::vector<std::vector<unsigned char>> messages(64);
+            std::vector<double> deltaTimes(messages.size());
+            std::vector<unsigned long long> absoluteTimes(messages.size());
+            while(run) {
+                // drain the whole queue on every wakeup
+                unsigned int count = 0;
+                pollWakeups++;
+                do {
+                    count = midiin->getMessages(&messages[0], &deltaTimes[0],
+                                                messages.size(), &absoluteTimes[0]);
+                    for(unsigned int i = 0; i < count; ++i) {
+                        inputMessage(context, deltaTimes[i], absoluteTimes[i],
+                                     messages[i]);
+                    }
+                } while(run && count == messages.size());
+                std::this_thread::sleep_for(sleepUS);
+            }
+        }
+
+        // done, closing the port also stops the input callback
+        midiin->closePort();
+        printer.stop();
+        context.capture.close();
+        context.record.close();
         std::cout << "stopped listening" << std::endl;
 
-        // done
+        // print stats
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - startTime;
+        std::cout << "received: " << (printer.printed + printer.dropped)
+                  << " messages, " << printer.dropped << " dropped" << std::endl
+                  << "printer: " << (printer.wakeups / elapsed.count())
+                  << " wakeups per sec, " << printer.writes << " writes"
+                  << std::endl;
+        if(speed > 0) {
+            std::cout << "poll: " << (pollWakeups / elapsed.count())
+                      << " wakeups per sec" << std::endl;
+        }
+        if(printer.printed > 0) {
+            std::cout << "latency: avg "
+                      << (printer.latencySum / printer.printed * 1000.0)
+                      << " ms, max " << (printer.latencyMax * 1000.0)
+                      << " ms (arrival to print)" << std::endl;
+        }
+        if(context.deltaTimes.count() > 0) {
+            printHistogram("delta time", context.deltaTimes);
+        }
+        if(capturePath != "") {
+            std::cout << "captured: " << context.capture.records
+                      << " messages, " << context.capture.writes
+                      << " writes" << std::endl;
+        }
+        if(recordPath != "") {
+            std::cout << "recorded: " << context.record.events << " events, "
+                      << context.record.skipped << " skipped" << std::endl;
+        }
+        histograms.push_back({"delta time", &context.deltaTimes});
+        if(histogramPath != "" && !writeHistograms(histogramPath, histograms)) {
+            return 1;
+        }
+    }
+    else if(tests == "capture-sysex") {
+        if(filePath == "") {
+            std::cout << "capture-sysex needs a --file to write to" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+        std::cout << "running tests: " << tests << std::endl
+                  << "port: " << port << std::endl
+                  << "file: " << filePath << std::endl;
+
+        // check if there is anything to receive from
+        if(midiin->getPortCount() == 0) {
+            std::cout << "no input ports available" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 0;
+        }
+
+        // chunks are written on a separate thread as they arrive
+        SysexCapture capture;
+        if(!capture.open(filePath)) {
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+        capture.start();
+        midiin->setSysexChunking(true);
+        midiin->setCallback(midiCaptureInput, &capture);
+        midiin->ignoreTypes(false, true, true);
+        midiin->openPort(port);
+        std::cout << "opened " << midiin->getPortName(port) << std::endl;
+
+        std::cout << "started capturing" << std::endl;
+        while(run && (count == 0 || capture.completed < count)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        // done, closing the port also stops the input callback
         midiin->closePort();
+        capture.stop();
+        std::cout << "stopped capturing" << std::endl;
+
+        // print stats
+        char crc[9];
+        std::snprintf(crc, sizeof(crc), "%08x", capture.crc);
+        std::cout << "captured: " << capture.completed << " messages, "
+                  << capture.bytes << " bytes in " << capture.chunks
+                  << " chunks, " << capture.dropped << " dropped" << std::endl
+                  << "writes: " << capture.writes << std::endl
+                  << "crc32: " << crc << std::endl;
+        double secs = capture.lastTime - capture.firstTime;
+        if(secs > 0) {
+            std::cout << "throughput: " << (capture.bytes / secs)
+                      << " bytes per sec, "
+                      << (capture.bytes / secs / SysexWriter::WIRE_RATE)
+                      << "x MIDI wire speed" << std::endl;
+        }
+    }
+    else if(tests == "replay") {
+        if(filePath == "") {
+            std::cout << "replay needs a --file capture to read" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+        std::cout << "running tests: " << tests << std::endl
+                  << "port: " << port << std::endl
+                  << "file: " << filePath << std::endl
+                  << "timing: " << (burst ? "no delay" : "original") << std::endl;
+
+        // read records in place from the mapped file
+        MappedFile file;
+        Capture::Reader reader;
+        if(!file.open(filePath) || !reader.open(file.data(), file.size())) {
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+
+        // check if there is anything to send to
+        if(midiout->getPortCount() == 0) {
+            std::cout << "no output ports available" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 0;
+        }
+        midiout->openPort(port);
+        std::cout << "opened " << midiout->getPortName(port) << std::endl;
+
+        Histogram scheduleErrors;
+        histograms.push_back({"schedule error", &scheduleErrors});
+        replayCapture(midiout, reader, burst, std::chrono::microseconds(spin),
+                      scheduleErrors);
+        midiout->closePort();
+        if(histogramPath != "" && !writeHistograms(histogramPath, histograms)) {
+            return 1;
+        }
+    }
+    else if(tests == "play") {
+        if(filePath == "") {
+            std::cout << "play needs a midi file to read" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+        std::cout << "running tests: " << tests << std::endl
+                  << "port: " << port << std::endl
+                  << "file: " << filePath << std::endl
+                  << "timing: " << (burst ? "no delay" : "original") << std::endl;
+
+        // events are parsed from the mapped file while playing
+        MappedFile file;
+        MidiFileReader reader;
+        if(!file.open(filePath) || !reader.open(file.data(), file.size())) {
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+        std::cout << "type " << reader.format << ", "
+                  << reader.getTrackCount() << " tracks" << std::endl;
+
+        // check if there is anything to send to
+        if(midiout->getPortCount() == 0) {
+            std::cout << "no output ports available" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 0;
+        }
+        midiout->openPort(port);
+        std::cout << "opened " << midiout->getPortName(port) << std::endl;
+
+        Histogram scheduleErrors;
+        histograms.push_back({"schedule error", &scheduleErrors});
+        playMidiFile(midiout, reader, burst, std::chrono::microseconds(spin),
+                     scheduleErrors);
+        midiout->closePort();
+        if(histogramPath != "" && !writeHistograms(histogramPath, histograms)) {
+            return 1;
+        }
+    }
+    else if(tests == "sysex-bulk") {
+        std::cout << "running tests: " << tests << std::endl;
+        if(virtualPort) {std::cout << "port: virtual" << std::endl;}
+        else {std::cout << "port: " << port << std::endl;}
+
+        // map the file or generate test data
+        MappedFile file;
+        std::vector<unsigned char> generated;
+        const unsigned char *data;
+        size_t dataSize;
+        if(filePath != "") {
+            if(!file.open(filePath)) {
+                delete midiin;
+                delete midiout;
+                return 1;
+            }
+            data = file.data();
+            dataSize = file.size();
+            std::cout << "file: " << filePath << ", " << dataSize << " bytes" << std::endl;
+        }
+        else {
+            // one large message to reassemble when looping back
+            if(virtualPort) {
+                generateSysex(generated, size > 0 ? size : 1048576,
+                              size > 0 ? size : 1048576);
+            }
+            else {
+                generateSysex(generated, size > 0 ? size : 1048576);
+            }
+            data = generated.data();
+            dataSize = generated.size();
+            std::cout << "generated: " << dataSize << " bytes" << std::endl;
+        }
+
+        if(virtualPort) {
+            // no wire to pace to, measure the send & receive path
+            if(byteRate < 0) byteRate = 0;
+            delete midiout;
+            midiout = openLoopback(midiin, "miditester sysex");
+            if(!midiout) {
+                delete midiin;
+                return 1;
+            }
+            midiin->ignoreTypes(false, true, true);
+            sysexLoopbackTest(midiin, midiout, data, dataSize, chunk, byteRate);
+            midiin->closePort();
+            delete midiin;
+            delete midiout;
+            return 0;
+        }
+
+        // check if there is anything to send to
+        if(midiout->getPortCount() == 0) {
+            std::cout << "no output ports available" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 0;
+        }
+        midiout->openPort(port);
+        std::cout << "opened " << midiout->getPortName(port) << std::endl;
+
+        Histogram sendTimes;
+        histograms.push_back({"send time", &sendTimes});
+        sendSysexBulk(midiout, data, dataSize, sendTimes);
+        midiout->closePort();
+        if(histogramPath != "" && !writeHistograms(histogramPath, histograms)) {
+            return 1;
+        }
+    }
+    else if(tests == "latency") {
+        if(speed < 0) speed = 10000;
+        if(count == 0) count = 1000;
+        if(inport < 0) inport = 0;
+
+        std::cout << "running tests: " << tests << std::endl;
+        if(virtualPort) {
+            std::cout << "port: virtual" << std::endl;
+        }
+        else {
+            std::cout << "port: " << port << std::endl
+                      << "inport: " << inport << std::endl;
+        }
+        std::cout << "speed: " << formatMicros(speed) << std::endl
+                  << "count: " << count << " probes" << std::endl;
+
+        // match echoes as they arrive
+        LatencyProbes probes(count);
+        midiin->setCallback(midiLatencyInput, &probes);
+
+        if(virtualPort) {
+            delete midiout;
+            midiout = openLoopback(midiin, "miditester latency");
+            if(!midiout) {
+                delete midiin;
+                return 1;
+            }
+        }
+        else {
+            // check if there is anything to send to & receive from
+            if(midiout->getPortCount() == 0 || midiin->getPortCount() == 0) {
+                std::cout << "no input or output ports available" << std::endl;
+                delete midiin;
+                delete midiout;
+                return 0;
+            }
+            midiout->openPort(port);
+            std::cout << "opened " << midiout->getPortName(port) << std::endl;
+            midiin->openPort(inport);
+            std::cout << "opened " << midiin->getPortName(inport) << std::endl;
+        }
+
+        // receive sysex probes
+        midiin->ignoreTypes(false, false, false);
+
+        Histogram roundTrips;
+        histograms.push_back({"round trip", &roundTrips});
+        latencyTest(midiin, midiout, probes, speed, roundTrips);
+        if(histogramPath != "" && !writeHistograms(histogramPath, histograms)) {
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
     }
     else {
         TestQueue queue;
-        if(speed < 0) speed = 500;
+        if(speed < 0) speed = 500000;
+        if(byteRate < 0) byteRate = (long)SysexWriter::WIRE_RATE;
 
         std::cout << "running tests: " << tests << std::endl
-          << "port: " << port << std::endl
-          << "channel: " << channel << std::endl
-          << "speed: " << speed << " ms" << std::endl;
+          << "port: " << portList << std::endl
+          << "channel: " << channel << std::endl;
+        if(burst) {
+            std::cout << "burst rate: ";
+            if(rate > 0) {std::cout << rate << " messages per sec" << std::endl;}
+            else {std::cout << "no delay" << std::endl;}
+            std::cout << "burst batch: " << batch << " messages" << std::endl;
+        }
+        else {
+            std::cout << "speed: " << formatMicros(speed) << std::endl;
+            if(schedule) {
+                if(midiout->getCurrentApi() != RtMidi::LINUX_ALSA) {
+                    std::cout << "--schedule is only supported with ALSA" << std::endl;
+                    delete midiin;
+                    delete midiout;
+                    return 1;
+                }
+                std::cout << "timing: driver queue" << std::endl;
+            }
+        }
 
         // check if there is anything to send to
         unsigned int numPorts = midiout->getPortCount();
@@ -284,9 +1143,26 @@ int main(int argc, char *argv[]) {
             return 0;
         }
 
+        // one port or several?
+        std::vector<unsigned int> ports;
+        if(!selectPorts(midiout, portList, ports)) {
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+        if(ports.size() > 1 && (verify || schedule || inport >= 0)) {
+            std::cout << "--verify, --schedule, & --inport need a single port" << std::endl;
+            delete midiin;
+            delete midiout;
+            return 1;
+        }
+
         // try opening given port
-        midiout->openPort(port);
-        std::cout << "opened " << midiout->getPortName(port) << std::endl;
+        if(ports.size() == 1) {
+            port = ports[0];
+            midiout->openPort(port);
+            std::cout << "opened " << midiout->getPortName(port) << std::endl;
+        }
         
         // prepare message queue
         bool allTests = (tests == "all");
@@ -302,22 +1178,139 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
-        // send messages
-        std::chrono::milliseconds sleepMS(speed);
-        for(auto &test : queue) {
-            if(!run) {break;}
-            std::cout << test.name << " test" << std::endl;
-            for(auto &message : test.messages) {
-                if(!run) {break;}
-                std::cout << "  sending ";
-                printMessage(message, hex, name);
-                midiout->sendMessage(&message);
-                std::this_thread::sleep_for(sleepMS);
+        Histogram sendTimes;      // time spent in sendMessage()
+        Histogram scheduleErrors; // send time - deadline
+        histograms.push_back({"send time", &sendTimes});
+        histograms.push_back({"schedule error", &scheduleErrors});
+
+        // send to several ports in parallel?
+        if(ports.size() > 1) {
+            std::vector<PortTest> portTests(ports.size());
+            for(size_t i = 0; i < ports.size(); ++i) {
+                PortTest &portTest = portTests[i];
+                portTest.port = ports[i];
+                std::string label = "port " + std::to_string(ports[i]);
+                histograms.push_back({label + " send time", &portTest.sendTimes});
+                histograms.push_back({label + " schedule error", &portTest.scheduleErrors});
+            }
+            sendParallel(midiout->getCurrentApi(), portTests, queue, speed, spin,
+                         burst, rate, batch, count, duration);
+            delete midiin;
+            delete midiout;
+            if(histogramPath != "" && !writeHistograms(histogramPath, histograms)) {
+                return 1;
+            }
+            return 0;
+        }
+
+        // compare what comes back on an input port against what was sent?
+        if(verify) {
+            if(inport < 0) inport = 0;
+            std::cout << "inport: " << inport << std::endl;
+            if(midiin->getPortCount() == 0) {
+                std::cout << "no input ports available" << std::endl;
+                delete midiin;
+                delete midiout;
+                return 1;
+            }
+            VerifyInput input;
+            midiin->setCallback(midiVerifyInput, &input);
+            midiin->ignoreTypes(false, false, false);
+            midiin->openPort(inport);
+            std::cout << "opened " << midiin->getPortName(inport) << std::endl;
+            unsigned int failed = verifyTests(midiout, queue, input, speed, spin, hex, name);
+            midiin->closePort();
+            midiout->closePort();
+            delete midiin;
+            delete midiout;
+            return (failed > 0 ? 2 : 0);
+        }
+
+        // measure how evenly messages arrive on an input port?
+        ArrivalJitter arrivals;
+        arrivals.interval = speed / 1000000.0;
+        if(inport >= 0 && !burst) {
+            if(midiin->getPortCount() == 0) {
+                std::cout << "no input ports available" << std::endl;
+                delete midiin;
+                delete midiout;
+                return 0;
             }
+            midiin->setCallback(midiJitterInput, &arrivals);
+            midiin->ignoreTypes(false, false, false);
+            midiin->openPort(inport);
+            std::cout << "opened " << midiin->getPortName(inport) << std::endl;
+            histograms.push_back({"arrival jitter", &arrivals.jitter});
         }
 
-        // done
-        midiout->closePort();
+        // throughput test?
+        if(burst) {
+            sendBurst(midiout, queue, rate, batch, count, duration,
+                      sendTimes, scheduleErrors);
+            midiout->closePort();
+        }
+        else if(schedule) {
+            sendScheduled(midiout, queue, speed, hex, name, sendTimes);
+            midiout->closePort();
+            std::cout << "sent: " << sendTimes.count() << " messages" << std::endl;
+            if(sendTimes.count() > 0) {
+                printHistogram("send time", sendTimes);
+            }
+        }
+        else {
+            // send messages at absolute deadlines, speed micros apart
+            Scheduler scheduler{std::chrono::microseconds(speed),
+                                std::chrono::microseconds(spin)};
+            for(auto &test : queue) {
+                if(!run) {break;}
+                std::cout << test.name << " test" << std::endl;
+                for(auto &message : test.messages) {
+                    if(!run) {break;}
+                    scheduler.wait();
+                    auto sendStart = Scheduler::Clock::now();
+                    midiout->sendMessage(&message);
+                    sendTimes.record(std::chrono::nanoseconds(
+                        Scheduler::Clock::now() - sendStart).count());
+                    std::cout << "  sending ";
+                    printMessage(message, hex, name);
+                }
+            }
+            scheduleErrors.merge(scheduler.errors);
+
+            // large sysex? it's sent as fast as the byte rate allows, not
+            // at the speed interval, so stop recording arrivals first
+            if(run && size > 0 && (allTests || tests == "sysex")) {
+                if(midiin->isPortOpen()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    midiin->closePort();
+                }
+                sendLargeSysex(midiout, size, chunk, byteRate);
+            }
+
+            // done
+            midiout->closePort();
+
+            // print stats
+            std::cout << "sent: " << sendTimes.count() << " messages" << std::endl;
+            if(sendTimes.count() > 0) {
+                printHistogram("send time", sendTimes);
+                printHistogram("schedule error", scheduleErrors);
+            }
+        }
+        if(inport >= 0 && !burst) {
+            if(midiin->isPortOpen()) {
+                // let the last message arrive
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                midiin->closePort();
+            }
+            std::cout << "received: " << arrivals.received << " messages" << std::endl;
+            if(arrivals.jitter.count() > 0) {
+                printHistogram("arrival jitter", arrivals.jitter);
+            }
+        }
+        if(histogramPath != "" && !writeHistograms(histogramPath, histograms)) {
+            return 1;
+        }
     }
 
     // cleanup
@@ -543,48 +1536,1101 @@ void timecode(TestQueue &queue) {
     queue.push_back(set);
 }
 
-// print MIDI mesage buffer to the console,
-// set hex to true to print byte values in hexidecimal
-// set name to true to print the name of the status bytes
+void frameNanos(std::vector<unsigned char> &framed, uint64_t nanos) {
+    for(int i = 0; i < TIME_HEADER_SIZE; ++i) {
+        framed.push_back((nanos >> (8 * i)) & 0xFF);
+    }
+}
+
+// append the framed time at the given offset as secs & the message bytes
+// after it as a line of text to a buffer
+static void formatFramedTime(const ByteTable &table,
+                             const std::vector<unsigned char> &message,
+                             size_t offset, std::string &buffer) {
+    uint64_t nanos = 0;
+    for(int i = TIME_HEADER_SIZE - 1; i >= 0; --i) {
+        nanos = (nanos << 8) | message[offset + i];
+    }
+    char text[32];
+    int size = snprintf(text, sizeof(text), "%6llu.%09llu  ",
+                        (unsigned long long)(nanos / 1000000000),
+                        (unsigned long long)(nanos % 1000000000));
+    buffer.append(text, size);
+    for(size_t i = offset + TIME_HEADER_SIZE; i < message.size(); ++i) {
+        const ByteText &entry = table[message[i]];
+        buffer.append(entry.text, entry.size);
+    }
+    buffer += '\n';
+}
+
+void formatTimedMessage(const ByteTable &table,
+                        const std::vector<unsigned char> &message,
+                        std::string &buffer) {
+    if(message.size() <= TIME_HEADER_SIZE) {return;}
+    formatFramedTime(table, message, 0, buffer);
+}
+
+void formatSourceMessage(const ByteTable &table,
+                         const std::vector<unsigned char> &message,
+                         std::string &buffer) {
+    if(message.size() <= SOURCE_HEADER_SIZE) {return;}
+    char text[8];
+    int size = snprintf(text, sizeof(text), "%3u ", message[0] | (message[1] << 8));
+    buffer.append(text, size);
+    formatFramedTime(table, message, 2, buffer);
+}
+
+// print MIDI mesage buffer to the console
 void printMessage(std::vector<unsigned char> &message, bool hex, bool name) {
-    if(message.size() < 1) {return;}
-    if(hex) {std::cout << std::hex << std::uppercase;}
-    for(int byte : message) {
-        if(name && (byte & 0x80)) {
-            std::cout << statusByteName(byte) << " ";
+    std::string line;
+    formatMessage(byteTable(hex, name), message, line);
+    std::cout << line;
+}
+
+void inputMessage(InputContext &context, double deltatime, uint64_t nanos,
+                  const std::vector<unsigned char> &message) {
+    context.deltaTimes.recordSeconds(deltatime);
+
+    // time since the first message from the absolute times, so rounding
+    // errors in the delta times don't add up over long sessions
+    if(context.startTime == 0) {context.startTime = nanos;}
+    uint64_t time = (nanos > context.startTime ? nanos - context.startTime : 0);
+    if(context.capture.isOpen()) {
+        context.capture.write(time, message.data(), message.size());
+    }
+    if(context.record.isOpen()) {
+        context.record.write(time / 1000000000.0, message.data(), message.size());
+    }
+
+    if(context.timestamps == TIMESTAMPS_NONE) {
+        context.printer->print(message, nanos);
+        return;
+    }
+    context.framed.clear();
+    if(context.timestamps == TIMESTAMPS_ABS) {
+        frameNanos(context.framed, nanos);
+    }
+    else {
+        frameNanos(context.framed, (uint64_t)std::llround(deltatime * 1000000000.0));
+    }
+    context.framed.insert(context.framed.end(), message.begin(), message.end());
+    context.printer->print(context.framed, nanos);
+}
+
+void midiInput(double deltatime, std::vector<unsigned char> *message, void *userData) {
+    InputContext *context = (InputContext *)userData;
+    inputMessage(*context, deltatime, context->midiin->getMessageTime(), *message);
+}
+
+void midiCaptureInput(double /*deltatime*/, std::vector<unsigned char> *message, void *userData) {
+    SysexCapture *capture = (SysexCapture *)userData;
+    capture->capture(*message);
+}
+
+void printHistogram(const std::string &label, const Histogram &histogram) {
+    std::cout << label << ": min " << (histogram.min() / 1000.0)
+              << " us, mean " << (histogram.mean() / 1000.0)
+              << " us, p50 " << (histogram.percentile(50) / 1000.0)
+              << " us, p99 " << (histogram.percentile(99) / 1000.0)
+              << " us, p99.9 " << (histogram.percentile(99.9) / 1000.0)
+              << " us, max " << (histogram.max() / 1000.0)
+              << " us, dev " << (histogram.dev() / 1000.0)
+              << " us" << std::endl;
+}
+
+bool writeHistograms(const std::string &path, const HistogramList &histograms) {
+    std::ofstream file(path);
+    if(!file.is_open()) {
+        std::cout << "could not open histogram file " << path << std::endl;
+        return false;
+    }
+    bool json = (path.size() > 5 && path.substr(path.size() - 5) == ".json");
+    if(json) {file << "{";}
+    bool first = true;
+    for(auto &histogram : histograms) {
+        if(json) {
+            file << (first ? "\n  " : ",\n  ") << "\"" << histogram.first << "\": ";
+            histogram.second->writeJson(file);
+        }
+        else {
+            histogram.second->writeCsv(file, histogram.first, first);
+        }
+        first = false;
+    }
+    if(json) {file << "\n}\n";}
+    std::cout << "wrote histograms to " << path << std::endl;
+    return true;
+}
+
+void sendBurst(RtMidiOut *midiout, TestQueue &queue, long rate,
+               unsigned int batch, unsigned long count, unsigned long duration,
+               Histogram &sendTimes, Histogram &scheduleErrors) {
+
+    // flatten test sets into a single message list
+    MessageQueue messages;
+    for(auto &test : queue) {
+        messages.insert(messages.end(), test.messages.begin(), test.messages.end());
+    }
+    if(messages.empty()) {return;}
+
+    // count send warnings instead of exiting
+    unsigned long dropped = 0;
+    midiout->setErrorCallback(midiBurstError, &dropped);
+
+    std::cout << "burst test" << std::endl;
+    if(count > 0) {std::cout << "count: " << count << " messages" << std::endl;}
+    if(duration > 0) {std::cout << "duration: " << duration << " s" << std::endl;}
+    std::cout << "started sending" << std::endl;
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    std::clock_t cpuStart = std::clock();
+    unsigned long sent, bytes;
+    unsigned long sends = sendBurstLoop(midiout, std::move(messages), rate, batch,
+                                        count, duration, sent, bytes,
+                                        sendTimes, scheduleErrors);
+    std::chrono::duration<double> elapsed = Scheduler::Clock::now() - start;
+    double cpu = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    midiout->setErrorCallback(midiError);
+    std::cout << "stopped sending" << std::endl;
+
+    // print stats, MIDI 1.0 runs at 31250 baud with 10 bits per byte
+    double secs = elapsed.count();
+    std::cout << "sent: " << sent << " messages, " << bytes << " bytes in "
+              << secs << " s" << std::endl
+              << "dropped: " << dropped << " messages" << std::endl
+              << "throughput: " << ((sent - dropped) / secs) << " messages per sec, "
+              << (bytes / secs) << " bytes per sec, "
+              << (bytes / secs / 3125.0) << "x MIDI wire speed" << std::endl
+              << "cpu time: " << cpu << " s, "
+              << (cpu / secs * 100.0) << "% of elapsed" << std::endl;
+    if(sent > 0) {
+        if(batch > 1) {
+            std::cout << "send calls: " << sends << ", "
+                      << ((double)sent / sends) << " messages per call" << std::endl;
+        }
+        printHistogram(batch > 1 ? "batch send time" : "send time", sendTimes);
+    }
+    if(scheduleErrors.count() > 0) {
+        printHistogram("schedule error", scheduleErrors);
+    }
+}
+
+unsigned long sendBurstLoop(RtMidiOut *midiout, MessageQueue messages, long rate,
+                            unsigned int batch, unsigned long count,
+                            unsigned long duration, unsigned long &sent,
+                            unsigned long &bytes, Histogram &sendTimes,
+                            Histogram &scheduleErrors) {
+
+    // repeat the message list up to at least a whole batch so batches
+    // don't have to wrap around the end
+    unsigned long listSize = messages.size();
+    while(messages.size() < listSize + batch) {
+        messages.push_back(messages[messages.size() - listSize]);
+    }
+
+    // one deadline per batch
+    Scheduler scheduler{std::chrono::nanoseconds(rate > 0 ? 1000000000L * batch / rate : 0)};
+    Scheduler::Clock::time_point end = Scheduler::Clock::now() + std::chrono::seconds(duration);
+    unsigned long sends = 0;
+    unsigned int index = 0;
+    sent = 0;
+    bytes = 0;
+    while(run) {
+        if(count > 0 && sent >= count) {break;}
+
+        // check the clock every so often, it's not free at these rates
+        if(duration > 0 && (sends & 0xFF) == 0 &&
+           Scheduler::Clock::now() >= end) {break;}
+
+        unsigned int size = batch;
+        if(count > 0 && count - sent < size) {size = count - sent;}
+        if(rate > 0) {scheduler.wait();}
+        auto sendStart = Scheduler::Clock::now();
+        if(size == 1) {
+            midiout->sendMessage(&messages[index]);
+        }
+        else {
+            midiout->sendMessages(&messages[index], size);
+        }
+        sendTimes.record(std::chrono::nanoseconds(
+            Scheduler::Clock::now() - sendStart).count());
+        for(unsigned int i = 0; i < size; ++i) {
+            bytes += messages[index + i].size();
+        }
+        sent += size;
+        sends++;
+        index = (index + size) % listSize; // batch may be longer than the list
+    }
+    if(rate > 0) {scheduleErrors.merge(scheduler.errors);}
+    return sends;
+}
+
+void latencyTest(RtMidiIn *midiin, RtMidiOut *midiout,
+                 LatencyProbes &probes, long interval, Histogram &roundTrips) {
+
+    // probe: F0 7D (non-commercial id) 4C ('L') then a 28 bit sequence
+    // number as 4 7-bit bytes, lsb first
+    std::vector<unsigned char> probe = {
+        MIDI_SYSEX, 0x7D, 0x4C, 0, 0, 0, 0, MIDI_SYSEXEND
+    };
+    unsigned long count = probes.sent.size();
+
+    std::cout << "latency test" << std::endl;
+    std::cout << "started sending" << std::endl;
+    Scheduler scheduler{std::chrono::microseconds(interval)};
+    unsigned long sent = 0;
+    for(; sent < count && run; ++sent) {
+        for(int i = 0; i < 4; ++i) {
+            probe[3 + i] = (sent >> (7 * i)) & 0x7F;
+        }
+        scheduler.wait();
+        probes.sent[sent] = steadyNanos();
+        midiout->sendMessage(&probe);
+    }
+
+    // wait up to a second for the last echoes
+    Scheduler::Clock::time_point end =
+        Scheduler::Clock::now() + std::chrono::seconds(1);
+    while(run && probes.received < sent && Scheduler::Clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cout << "stopped sending" << std::endl;
+
+    // done, closing the input port also stops the input callback
+    midiin->closePort();
+    midiout->closePort();
+
+    // round trips in send order, jitter as mean difference between
+    // consecutive round trips
+    unsigned long received = 0;
+    double jitter = 0, last = -1;
+    for(unsigned long i = 0; i < sent; ++i) {
+        double roundTrip = probes.roundTrips[i];
+        if(roundTrip < 0) {continue;}
+        roundTrips.recordSeconds(roundTrip);
+        if(last >= 0) {jitter += std::fabs(roundTrip - last);}
+        last = roundTrip;
+        received++;
+    }
+    std::cout << "sent: " << sent << " probes, received " << received
+              << ", lost " << (sent - received) << ", duplicates "
+              << probes.duplicates << ", other " << probes.other
+              << " messages" << std::endl;
+    if(received == 0) {return;}
+    if(received > 1) {jitter /= (received - 1);}
+    printHistogram("round trip", roundTrips);
+    std::cout << "jitter: " << (jitter * 1000000.0) << " us" << std::endl;
+}
+
+void midiLatencyInput(double /*deltatime*/, std::vector<unsigned char> *message, void *userData) {
+    uint64_t time = steadyNanos();
+    LatencyProbes *probes = (LatencyProbes *)userData;
+    std::vector<unsigned char> &bytes = *message;
+    if(bytes.size() != 8 || bytes[0] != MIDI_SYSEX || bytes[1] != 0x7D ||
+       bytes[2] != 0x4C || bytes[7] != MIDI_SYSEXEND) {
+        probes->other++;
+        return;
+    }
+    unsigned long sequence = 0;
+    for(int i = 0; i < 4; ++i) {
+        sequence |= (unsigned long)(bytes[3 + i] & 0x7F) << (7 * i);
+    }
+    if(sequence >= probes->sent.size() || probes->sent[sequence] == 0) {
+        probes->other++;
+        return;
+    }
+    if(probes->roundTrips[sequence] >= 0) {
+        probes->duplicates++;
+        return;
+    }
+    probes->roundTrips[sequence] =
+        (time - probes->sent[sequence]) / 1000000000.0;
+    probes->received++;
+}
+
+void sendScheduled(RtMidiOut *midiout, TestQueue &queue, long speed,
+                   bool hex, bool name, Histogram &sendTimes) {
+    double interval = speed / 1000000.0;
+    double ahead = std::min(1.0, 256 * interval);
+    double start = midiout->getQueueTime() + 0.1; // lead time for the first message
+    double time = start;
+    for(auto &test : queue) {
+        if(!run) {break;}
+        std::cout << test.name << " test" << std::endl;
+        for(auto &message : test.messages) {
+            if(!run) {break;}
+            while(run && time - midiout->getQueueTime() > ahead) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            auto sendStart = Scheduler::Clock::now();
+            midiout->sendMessageAt(&message, time);
+            sendTimes.record(std::chrono::nanoseconds(
+                Scheduler::Clock::now() - sendStart).count());
+            std::cout << "  scheduling ";
+            printMessage(message, hex, name);
+            time += interval;
+        }
+    }
+
+    // wait for the queue to deliver the rest, closing the port drops them
+    while(run && midiout->getQueueTime() < time) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void midiJitterInput(double deltatime, std::vector<unsigned char> * /*message*/, void *userData) {
+    ArrivalJitter *arrivals = (ArrivalJitter *)userData;
+    if(arrivals->received++ == 0) {return;} // no interval yet
+    arrivals->jitter.recordSeconds(std::fabs(deltatime - arrivals->interval));
+}
+
+void midiVerifyInput(double /*deltatime*/, std::vector<unsigned char> *message, void *userData) {
+    VerifyInput *input = (VerifyInput *)userData;
+    std::lock_guard<std::mutex> lock(input->mutex);
+    input->received.push_back(*message);
+}
+
+unsigned int verifyTests(RtMidiOut *midiout, TestQueue &queue, VerifyInput &input,
+                         long speed, long spin, bool hex, bool name) {
+    Scheduler scheduler{std::chrono::microseconds(speed),
+                        std::chrono::microseconds(spin)};
+    unsigned int verified = 0, failed = 0;
+    for(auto &test : queue) {
+        if(!run) {break;}
+        MessageQueue expected;
+        expectedMessages(test.messages, expected);
+        {
+            std::lock_guard<std::mutex> lock(input.mutex);
+            input.received.clear();
+        }
+
+        // send
+        std::cout << test.name << " test" << std::endl;
+        scheduler.start();
+        for(auto &message : test.messages) {
+            if(!run) {break;}
+            scheduler.wait();
+            midiout->sendMessage(&message);
+            std::cout << "  sending ";
+            printMessage(message, hex, name);
+        }
+        if(!run) {break;}
+
+        // wait up to a second for everything to arrive, then a little
+        // longer to catch extra messages
+        Scheduler::Clock::time_point timeout = Scheduler::Clock::now() + std::chrono::seconds(1);
+        while(run && Scheduler::Clock::now() < timeout) {
+            {
+                std::lock_guard<std::mutex> lock(input.mutex);
+                if(input.received.size() >= expected.size()) {break;}
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        MessageQueue received;
+        {
+            std::lock_guard<std::mutex> lock(input.mutex);
+            received.swap(input.received);
+        }
+        if(!verifyMessages(test.name, expected, received, hex, name)) {
+            failed++;
+        }
+        verified++;
+    }
+    std::cout << "verified: " << verified << " tests, " << failed
+              << " failed" << std::endl;
+    return failed;
+}
+
+void expectedMessages(const MessageQueue &sent, MessageQueue &expected) {
+    std::vector<unsigned char> message, sysex;
+    unsigned char runningStatus = 0;
+    for(auto &bytes : sent) {
+        for(unsigned char byte : bytes) {
+            if(byte >= MIDI_CLOCK) {
+                // realtime, passed on right away
+                expected.push_back({byte});
+                continue;
+            }
+            if(!sysex.empty()) {
+                if(byte < 0x80) {
+                    sysex.push_back(byte);
+                    continue;
+                }
+                if(byte == MIDI_SYSEXEND) {
+                    sysex.push_back(byte);
+                    expected.push_back(sysex);
+                }
+                sysex.clear(); // unfinished sysex is dropped
+                if(byte == MIDI_SYSEXEND) {continue;}
+            }
+            if(byte == MIDI_SYSEX) {
+                sysex.push_back(byte);
+                runningStatus = 0;
+                message.clear();
+                continue;
+            }
+            if(byte >= 0x80) {
+                // system common messages cancel running status
+                runningStatus = (byte < MIDI_SYSEX ? byte : 0);
+                message.assign(1, byte);
+            }
+            else if(!message.empty()) {
+                message.push_back(byte);
+            }
+            else if(runningStatus) {
+                message = {runningStatus, byte};
+            }
+            else {
+                continue; // stray data byte
+            }
+
+            // complete?
+            unsigned char status = message[0];
+            size_t size = 3;
+            if((status & 0xE0) == MIDI_PROGRAMCHANGE ||
+               status == MIDI_TIMECODE || status == MIDI_SONGSELECT) {
+                size = 2;
+            }
+            else if(status >= MIDI_SYSEX && status != MIDI_SONGPOS) {
+                size = 1;
+            }
+            if(message.size() == size) {
+                expected.push_back(message);
+                message.clear();
+            }
+        }
+    }
+}
+
+bool verifyMessages(const std::string &label, const MessageQueue &expected,
+                    const MessageQueue &received, bool hex, bool name) {
+
+    // match each received message to the first unused expected one
+    std::vector<bool> used(expected.size(), false);
+    std::vector<size_t> order; // expected index of each match in arrival order
+    unsigned long unexpected = 0;
+    for(auto &message : received) {
+        size_t i = 0;
+        while(i < expected.size() && (used[i] || expected[i] != message)) {i++;}
+        if(i == expected.size()) {
+            std::vector<unsigned char> copy = message;
+            std::cout << "  unexpected ";
+            printMessage(copy, hex, name);
+            unexpected++;
+            continue;
+        }
+        used[i] = true;
+        order.push_back(i);
+    }
+    unsigned long dropped = 0;
+    for(size_t i = 0; i < expected.size(); ++i) {
+        if(!used[i]) {
+            std::vector<unsigned char> copy = expected[i];
+            std::cout << "  dropped ";
+            printMessage(copy, hex, name);
+            dropped++;
+        }
+    }
+
+    // messages out of order: matches outside the longest increasing
+    // run of expected positions
+    std::vector<size_t> tails;
+    for(size_t index : order) {
+        auto it = std::lower_bound(tails.begin(), tails.end(), index);
+        if(it == tails.end()) {tails.push_back(index);}
+        else {*it = index;}
+    }
+    unsigned long reordered = order.size() - tails.size();
+
+    bool pass = (unexpected == 0 && dropped == 0 && reordered == 0);
+    std::cout << label << ": " << (pass ? "pass" : "FAIL") << ", received "
+              << received.size() << " of " << expected.size() << ", "
+              << dropped << " dropped, " << unexpected << " unexpected, "
+              << reordered << " reordered" << std::endl;
+    return pass;
+}
+
+void midiMergeInput(double deltatime, std::vector<unsigned char> *message, void *userData) {
+    MergeSource *source = (MergeSource *)userData;
+    if(!source->queue.push(*message, deltatime, source->midiin->getMessageTime())) {
+        source->dropped++;
+    }
+}
+
+void mergeInputs(RtMidi::Api api, const std::vector<unsigned int> &ports,
+                 long speed, int flushInterval, bool hex, bool name,
+                 Timestamps timestamps) {
+
+    // messages are only merged once they are this old, so a message
+    // stamped just before another but queued just after is not missed,
+    // the driver times are on the steady clock
+    const uint64_t window = 1000000; // nanos
+
+    // a client & queue per port
+    std::vector<MergeSource> sources(ports.size());
+    for(size_t i = 0; i < ports.size(); ++i) {
+        MergeSource &source = sources[i];
+        source.port = ports[i];
+        source.queue.allocate(4096);
+        source.midiin = new RtMidiIn(api, "miditester");
+        source.midiin->setErrorCallback(midiError);
+        source.midiin->setCallback(midiMergeInput, &source);
+        source.midiin->ignoreTypes(false, false, false);
+        source.midiin->openPort(source.port);
+        std::cout << "opened " << source.port << ": "
+                  << source.midiin->getPortName(source.port) << std::endl;
+    }
+
+    const ByteTable &table = byteTable(hex, name);
+    Printer printer([&table](std::string &buffer,
+                             const std::vector<unsigned char> &message) {
+        formatSourceMessage(table, message, buffer);
+    });
+    printer.start(std::chrono::milliseconds(flushInterval));
+
+    // k-way merge of the queue heads, oldest first
+    typedef std::pair<unsigned long long, size_t> Head; // absolute time, source index
+    std::vector<Head> heads;
+    std::vector<unsigned char> message, framed;
+    uint64_t startTime = steadyNanos();
+    uint64_t lastTime = 0;
+    unsigned long pollWakeups = 0;
+    auto merge = [&](uint64_t until) {
+        double stamp;
+        unsigned long long nanos;
+        heads.clear();
+        for(size_t i = 0; i < sources.size(); ++i) {
+            if(sources[i].queue.peek(&stamp, &nanos)) {heads.push_back({nanos, i});}
+        }
+        std::make_heap(heads.begin(), heads.end(), std::greater<Head>());
+        while(!heads.empty() && heads.front().first <= until) {
+            std::pop_heap(heads.begin(), heads.end(), std::greater<Head>());
+            size_t index = heads.back().second;
+            heads.pop_back();
+            MergeSource &source = sources[index];
+            source.queue.pop(&message, &stamp, &nanos);
+            source.received++;
+
+            // frame with port & time
+            uint64_t time = nanos;
+            if(timestamps == TIMESTAMPS_DELTA) {
+                time = (lastTime > 0 && nanos > lastTime ? nanos - lastTime : 0);
+            }
+            else if(timestamps == TIMESTAMPS_NONE) {
+                time = (nanos > startTime ? nanos - startTime : 0);
+            }
+            lastTime = nanos;
+            framed.assign({(unsigned char)(source.port & 0xFF),
+                           (unsigned char)(source.port >> 8)});
+            frameNanos(framed, time);
+            framed.insert(framed.end(), message.begin(), message.end());
+            printer.print(framed, nanos);
+
+            if(source.queue.peek(&stamp, &nanos)) {
+                heads.push_back({nanos, index});
+                std::push_heap(heads.begin(), heads.end(), std::greater<Head>());
+            }
+        }
+    };
+
+    // merge until stopped
+    std::chrono::microseconds sleepUS(speed > 0 ? speed : 1000);
+    std::cout << "input test" << std::endl
+              << "merging " << sources.size() << " ports every "
+              << formatMicros(sleepUS.count()) << std::endl
+              << "started listening" << std::endl;
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    while(run) {
+        pollWakeups++;
+        merge(steadyNanos() - window);
+        std::this_thread::sleep_for(sleepUS);
+    }
+
+    // closing the ports stops the callbacks, then merge the rest
+    for(auto &source : sources) {
+        source.midiin->closePort();
+    }
+    merge(std::numeric_limits<uint64_t>::max());
+    printer.stop();
+    std::cout << "stopped listening" << std::endl;
+
+    // print stats
+    std::chrono::duration<double> elapsed = Scheduler::Clock::now() - start;
+    unsigned long received = 0, dropped = 0;
+    for(auto &source : sources) {
+        std::cout << "port " << source.port << ": received " << source.received
+                  << " messages, " << source.dropped << " dropped" << std::endl;
+        received += source.received;
+        dropped += source.dropped;
+        delete source.midiin;
+    }
+    std::cout << "received: " << received << " messages, " << dropped
+              << " dropped, " << printer.dropped << " not printed" << std::endl
+              << "poll: " << (pollWakeups / elapsed.count())
+              << " wakeups per sec" << std::endl
+              << "printer: " << (printer.wakeups / elapsed.count())
+              << " wakeups per sec, " << printer.writes << " writes" << std::endl;
+}
+
+void sendSysexBulk(RtMidiOut *midiout, const unsigned char *data, size_t size,
+                   Histogram &sendTimes) {
+
+    // count send warnings instead of exiting
+    unsigned long dropped = 0;
+    midiout->setErrorCallback(midiBurstError, &dropped);
+
+    std::cout << "started sending" << std::endl;
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    unsigned long sent = 0, bytes = 0;
+    size_t pos = 0, length;
+    const unsigned char *begin;
+    while(run && nextSysex(data, size, pos, begin, length)) {
+        auto sendStart = Scheduler::Clock::now();
+        midiout->sendMessage(begin, length);
+        sendTimes.record(std::chrono::nanoseconds(
+            Scheduler::Clock::now() - sendStart).count());
+        bytes += length;
+        sent++;
+    }
+    std::chrono::duration<double> elapsed = Scheduler::Clock::now() - start;
+    midiout->setErrorCallback(midiError);
+    std::cout << "stopped sending" << std::endl;
+
+    // print stats
+    double secs = elapsed.count();
+    std::cout << "sent: " << sent << " sysex messages, " << bytes << " bytes in "
+              << secs << " s" << std::endl
+              << "dropped: " << dropped << " messages" << std::endl;
+    if(sent > 0) {
+        std::cout << "throughput: " << (bytes / secs) << " bytes per sec, "
+                  << (bytes / secs / 3125.0) << "x MIDI wire speed" << std::endl;
+        printHistogram("send time", sendTimes);
+    }
+}
+
+void generateSysex(std::vector<unsigned char> &data, size_t size,
+                   size_t messageSize) {
+    data.clear();
+    data.reserve(size);
+    while(data.size() + 3 <= size) {
+        size_t length = std::min(messageSize, size - data.size());
+        data.push_back(MIDI_SYSEX);
+        data.push_back(0x7D); // non-commercial id
+        for(size_t i = 2; i < length - 1; ++i) {
+            data.push_back(i & 0x7F);
+        }
+        data.push_back(MIDI_SYSEXEND);
+    }
+}
+
+bool nextSysex(const unsigned char *data, size_t size, size_t &pos,
+               const unsigned char *&message, size_t &length) {
+    if(pos >= size) {return false;}
+    const unsigned char *begin = (const unsigned char *)std::memchr(data + pos, MIDI_SYSEX, size - pos);
+    if(!begin) {return false;}
+    const unsigned char *end = (const unsigned char *)std::memchr(begin, MIDI_SYSEXEND, data + size - begin);
+    if(!end) {return false;}
+    message = begin;
+    length = end - begin + 1;
+    pos = end - data + 1;
+    return true;
+}
+
+void replayCapture(RtMidiOut *midiout, Capture::Reader &reader, bool burst,
+                   std::chrono::microseconds spin, Histogram &scheduleErrors) {
+
+    // count send warnings instead of exiting
+    unsigned long dropped = 0;
+    midiout->setErrorCallback(midiBurstError, &dropped);
+
+    std::cout << "started sending" << std::endl;
+    Scheduler scheduler{std::chrono::nanoseconds(0), spin};
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    unsigned long sent = 0, bytes = 0;
+    uint64_t nanos, lastNanos = 0;
+    const unsigned char *message;
+    size_t size;
+    while(run && reader.next(nanos, message, size)) {
+        if(!burst) {
+            scheduler.waitUntil(start + std::chrono::nanoseconds(nanos));
+        }
+        midiout->sendMessage(message, size);
+        bytes += size;
+        sent++;
+        lastNanos = nanos;
+    }
+    std::chrono::duration<double> elapsed = Scheduler::Clock::now() - start;
+    scheduleErrors.merge(scheduler.errors);
+    midiout->setErrorCallback(midiError);
+    std::cout << "stopped sending" << std::endl;
+
+    // print stats
+    std::cout << "sent: " << sent << " messages, " << bytes << " bytes in "
+              << elapsed.count() << " s, captured in "
+              << (lastNanos / 1000000000.0) << " s" << std::endl
+              << "dropped: " << dropped << " messages" << std::endl;
+    if(scheduleErrors.count() > 0) {
+        printHistogram("schedule error", scheduleErrors);
+    }
+}
+
+void playMidiFile(RtMidiOut *midiout, MidiFileReader &reader, bool burst,
+                  std::chrono::microseconds spin, Histogram &scheduleErrors) {
+
+    // count send warnings instead of exiting
+    unsigned long dropped = 0;
+    midiout->setErrorCallback(midiBurstError, &dropped);
+
+    std::cout << "started playing" << std::endl;
+    Scheduler scheduler{std::chrono::nanoseconds(0), spin};
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    unsigned long sent = 0, bytes = 0;
+    double seconds, lastSeconds = 0;
+    const unsigned char *message;
+    size_t size;
+    while(run && reader.next(seconds, message, size)) {
+        if(!burst) {
+            // deadlines are from the start so errors do not add up
+            scheduler.waitUntil(start +
+                std::chrono::duration_cast<Scheduler::Clock::duration>(
+                    std::chrono::duration<double>(seconds)));
+        }
+        midiout->sendMessage(message, size);
+        bytes += size;
+        sent++;
+        lastSeconds = seconds;
+    }
+    std::chrono::duration<double> elapsed = Scheduler::Clock::now() - start;
+    scheduleErrors.merge(scheduler.errors);
+
+    // don't leave notes hanging if stopped early
+    if(!run) {
+        for(unsigned char channel = 0; channel < 16; ++channel) {
+            const unsigned char allNotesOff[3] = {
+                (unsigned char)(MIDI_CONTROLCHANGE + channel), 123, 0
+            };
+            midiout->sendMessage(allNotesOff, 3);
+        }
+    }
+    midiout->setErrorCallback(midiError);
+    std::cout << "stopped playing" << std::endl;
+
+    // print stats
+    std::cout << "sent: " << sent << " messages, " << bytes << " bytes in "
+              << elapsed.count() << " s, file time " << lastSeconds
+              << " s" << std::endl
+              << "tempo changes: " << reader.tempoChanges << std::endl
+              << "dropped: " << dropped << " messages" << std::endl;
+    if(reader.errors > 0) {
+        std::cout << "errors: " << reader.errors << " tracks cut short" << std::endl;
+    }
+    if(scheduleErrors.count() > 0) {
+        printHistogram("schedule error", scheduleErrors);
+    }
+}
+
+void sysexLoopbackTest(RtMidiIn *midiin, RtMidiOut *midiout,
+                       const unsigned char *data, size_t size,
+                       size_t chunk, double byteRate) {
+
+    // expected messages
+    unsigned long expectedMessages = 0, expectedBytes = 0;
+    size_t pos = 0, length;
+    const unsigned char *begin;
+    while(nextSysex(data, size, pos, begin, length)) {
+        expectedMessages++;
+        expectedBytes += length;
+    }
+    if(expectedMessages == 0) {
+        std::cout << "no sysex messages to send" << std::endl;
+        return;
+    }
+
+    // receive on a separate thread while sending, polling the input queue
+    std::atomic<bool> receiving(true);
+    std::atomic<unsigned long> received(0), receivedBytes(0);
+    unsigned long invalid = 0;
+    Scheduler::Clock::time_point start = Scheduler::Clock::now(), lastReceived;
+    std::thread receiver([&] {
+        std::vector<unsigned char> message;
+        while(receiving) {
+            midiin->getMessage(&message);
+            if(message.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            lastReceived = Scheduler::Clock::now();
+            if(message.front() != MIDI_SYSEX || message.back() != MIDI_SYSEXEND) {
+                invalid++;
+            }
+            receivedBytes += message.size();
+            received++;
+        }
+    });
+
+    if(byteRate > 0) {std::cout << byteRate << " bytes per sec" << std::endl;}
+    else {std::cout << "no pacing" << std::endl;}
+    SysexWriter writer(midiout, chunk, byteRate);
+    writer.setErrorCallback(midiError);
+    std::cout << "started sending " << expectedMessages << " messages ";
+    if(writer.isChunked()) {std::cout << "in " << chunk << " byte chunks" << std::endl;}
+    else {std::cout << "unchunked, the API can't take partial sysex" << std::endl;}
+    unsigned long stalls = 0;
+    pos = 0;
+    while(run && nextSysex(data, size, pos, begin, length)) {
+        if(!writer.write(begin, length)) {break;}
+        stalls += writer.stalls;
+    }
+    std::chrono::duration<double> sendTime = Scheduler::Clock::now() - start;
+
+    // wait up to a second for the rest
+    Scheduler::Clock::time_point timeout = Scheduler::Clock::now() + std::chrono::seconds(1);
+    while(run && receivedBytes < expectedBytes && Scheduler::Clock::now() < timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    receiving = false;
+    receiver.join();
+    std::cout << "stopped sending" << std::endl;
+
+    // print stats
+    std::cout << "sent: " << expectedMessages << " messages, " << expectedBytes
+              << " bytes in " << sendTime.count() << " s, " << stalls
+              << " stalls" << std::endl
+              << "received: " << received << " messages, " << receivedBytes
+              << " bytes, " << invalid << " invalid" << std::endl;
+    if(received > 0) {
+        std::chrono::duration<double> receiveTime = lastReceived - start;
+        std::cout << "throughput: " << (receivedBytes / receiveTime.count())
+                  << " bytes per sec, "
+                  << (receivedBytes / receiveTime.count() / SysexWriter::WIRE_RATE)
+                  << "x MIDI wire speed" << std::endl;
+    }
+}
+
+void sendLargeSysex(RtMidiOut *midiout, size_t size, size_t chunk, double byteRate) {
+    std::vector<unsigned char> data;
+    generateSysex(data, 3); // F0 7D F7
+    data.pop_back();
+    for(size_t i = 3; i < size; ++i) {
+        data.push_back(i & 0x7F);
+    }
+    data.push_back(MIDI_SYSEXEND);
+
+    SysexWriter writer(midiout, chunk, byteRate);
+    writer.setErrorCallback(midiError);
+    std::cout << "large sysex test" << std::endl
+              << "  sending " << data.size() << " bytes ";
+    if(!writer.isChunked()) {
+        std::cout << "unchunked, the API can't take partial sysex" << std::endl;
+    }
+    else {
+        std::cout << "in " << chunk << " byte chunks at ";
+        if(byteRate > 0) {std::cout << byteRate << " bytes per sec" << std::endl;}
+        else {std::cout << "no pacing" << std::endl;}
+    }
+
+    // print progress every 10%
+    size_t next = 0;
+    bool ok = writer.write(data.data(), data.size(), [&](size_t written, size_t total) {
+        if(written * 10 >= next * total) {
+            std::cout << "  " << (written * 100 / total) << "% " << written
+                      << " bytes" << std::endl;
+            next = written * 10 / total + 1;
+        }
+        return run != 0;
+    });
+
+    // print stats
+    std::cout << "  " << (ok ? "sent " : "aborted after ") << writer.written
+              << " bytes, " << writer.chunks << " chunks, " << writer.stalls
+              << " stalls in " << writer.elapsed << " s" << std::endl;
+    if(writer.elapsed > 0) {
+        std::cout << "  throughput: " << (writer.written / writer.elapsed)
+                  << " bytes per sec, "
+                  << (writer.written / writer.elapsed / SysexWriter::WIRE_RATE)
+                  << "x MIDI wire speed" << std::endl;
+    }
+}
+
+bool selectPorts(RtMidi *midi, const std::string &list, std::vector<unsigned int> &ports) {
+    unsigned int count = midi->getPortCount();
+    size_t start = 0;
+    while(start <= list.size()) {
+        size_t end = list.find(',', start);
+        if(end == std::string::npos) {end = list.size();}
+        std::string item = list.substr(start, end - start);
+        start = end + 1;
+        if(item.empty()) {continue;}
+
+        // number or range, a single number is left to openPort() to check
+        // as before
+        size_t dash = item.find('-');
+        std::vector<unsigned int> selected;
+        if(isnumeric(item)) {
+            selected.push_back(std::atoi(item.c_str()));
+        }
+        else if(dash != std::string::npos && dash > 0 &&
+                isnumeric(item.substr(0, dash)) && isnumeric(item.substr(dash + 1)) &&
+                dash + 1 < item.size()) {
+            unsigned int first = std::atoi(item.substr(0, dash).c_str());
+            unsigned int last = std::atoi(item.substr(dash + 1).c_str());
+            if(first > last || last >= count) {
+                std::cout << "port range " << item << " is not within 0-"
+                          << (count > 0 ? count - 1 : 0) << std::endl;
+                return false;
+            }
+            for(unsigned int i = first; i <= last; ++i) {selected.push_back(i);}
         }
         else {
-            std::cout << byte << " ";
-        }
-    }
-    if(hex) {std::cout << std::nouppercase << std::dec; }
-    std::cout << std::endl;
-}
-
-std::string statusByteName(unsigned char status) {
-    if(status < MIDI_SYSEX) status = status & 0xF0;
-    switch(status) {
-        case MIDI_NOTEOFF:        return "NOTEOFF";
-        case MIDI_NOTEON:         return "NOTEON";
-        case MIDI_POLYAFTERTOUCH: return "POLYAFTERTOUCH";
-        case MIDI_CONTROLCHANGE:  return "CONTROLCHANGE";
-        case MIDI_PROGRAMCHANGE:  return "PROGRAMCHANGE";
-        case MIDI_AFTERTOUCH:     return "AFTERTOUCH";
-        case MIDI_PITCHBEND:      return "PITCHBEND";
-        case MIDI_SYSEX:          return "SYSEX";
-        case MIDI_TIMECODE:       return "TIMECODE";
-        case MIDI_SONGPOS:        return "SONGPOS";
-        case MIDI_SONGSELECT:     return "SONGSELECT";
-        case MIDI_TUNEREQUEST:    return "TUNEREQUEST";
-        case MIDI_SYSEXEND:       return "SYSEXEND";
-        case MIDI_CLOCK:          return "CLOCK";
-        case MIDI_START:          return "START";
-        case MIDI_CONTINUE:       return "CONTINUE";
-        case MIDI_STOP:           return "STOP";
-        case MIDI_ACTIVESENSING:  return "ACTIVESENSE";
-        case MIDI_SYSTEMRESET:    return "SYSTEMRESET";
-        default:                  return "UNKNOWN";
+            for(unsigned int i = 0; i < count; ++i) {
+                if(midi->getPortName(i).find(item) != std::string::npos) {
+                    selected.push_back(i);
+                }
+            }
+            if(selected.empty()) {
+                std::cout << "no port name contains \"" << item << "\"" << std::endl;
+                return false;
+            }
+        }
+
+        // skip duplicates
+        for(unsigned int i : selected) {
+            if(std::find(ports.begin(), ports.end(), i) == ports.end()) {
+                ports.push_back(i);
+            }
+        }
+    }
+    if(ports.empty()) {
+        std::cout << "no ports selected" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void sendParallel(RtMidi::Api api, std::vector<PortTest> &portTests, TestQueue &queue,
+                  long speed, long spin, bool burst, long rate, unsigned int batch,
+                  unsigned long count, unsigned long duration) {
+
+    // flatten test sets into a single message list
+    MessageQueue messages;
+    for(auto &test : queue) {
+        messages.insert(messages.end(), test.messages.begin(), test.messages.end());
+    }
+    if(messages.empty()) {return;}
+
+    // a client per port so sending on one never waits on another,
+    // send warnings are counted instead of exiting
+    for(auto &portTest : portTests) {
+        portTest.midiout = new RtMidiOut(api, "miditester");
+        portTest.midiout->setErrorCallback(midiBurstError, &portTest.dropped);
+        portTest.midiout->openPort(portTest.port);
+        portTest.name = portTest.midiout->getPortName(portTest.port);
+        std::cout << "opened " << portTest.name << std::endl;
+    }
+
+    std::cout << "started sending to " << portTests.size() << " ports" << std::endl;
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    std::vector<std::thread> threads;
+    for(auto &portTest : portTests) {
+        threads.emplace_back(sendPortTest, std::ref(portTest), std::cref(messages),
+                             speed, spin, burst, rate, batch, count, duration);
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = Scheduler::Clock::now() - start;
+    std::cout << "stopped sending" << std::endl;
+
+    // print stats per port & in total
+    unsigned long sent = 0, bytes = 0, dropped = 0;
+    for(auto &portTest : portTests) {
+        portTest.midiout->closePort();
+        delete portTest.midiout;
+        portTest.midiout = nullptr;
+        std::cout << "port " << portTest.port << ": " << portTest.name << std::endl
+                  << "  sent: " << portTest.sent << " messages, " << portTest.bytes
+                  << " bytes in " << portTest.elapsed << " s, "
+                  << portTest.dropped << " dropped" << std::endl;
+        if(burst && portTest.elapsed > 0) {
+            std::cout << "  throughput: " << ((portTest.sent - portTest.dropped) / portTest.elapsed)
+                      << " messages per sec" << std::endl;
+        }
+        if(portTest.sendTimes.count() > 0) {
+            printHistogram("  send time", portTest.sendTimes);
+        }
+        if(portTest.scheduleErrors.count() > 0) {
+            printHistogram("  schedule error", portTest.scheduleErrors);
+        }
+        sent += portTest.sent;
+        bytes += portTest.bytes;
+        dropped += portTest.dropped;
+    }
+    std::cout << "total: " << sent << " messages, " << bytes << " bytes to "
+              << portTests.size() << " ports in " << elapsed.count() << " s, "
+              << dropped << " dropped" << std::endl;
+}
+
+void sendPortTest(PortTest &portTest, const MessageQueue &messages, long speed,
+                  long spin, bool burst, long rate, unsigned int batch,
+                  unsigned long count, unsigned long duration) {
+    RtMidiOut *midiout = portTest.midiout;
+    Scheduler::Clock::time_point start = Scheduler::Clock::now();
+    if(!burst) {
+        // the test messages once at absolute deadlines, speed micros apart
+        Scheduler scheduler{std::chrono::microseconds(speed),
+                            std::chrono::microseconds(spin)};
+        for(auto &message : messages) {
+            if(!run) {break;}
+            scheduler.wait();
+            auto sendStart = Scheduler::Clock::now();
+            midiout->sendMessage(message.data(), message.size());
+            portTest.sendTimes.record(std::chrono::nanoseconds(
+                Scheduler::Clock::now() - sendStart).count());
+            portTest.bytes += message.size();
+            portTest.sent++;
+        }
+        portTest.scheduleErrors.merge(scheduler.errors);
+    }
+    else {
+        sendBurstLoop(midiout, messages, rate, batch, count, duration,
+                      portTest.sent, portTest.bytes, portTest.sendTimes,
+                      portTest.scheduleErrors);
+    }
+    std::chrono::duration<double> elapsed = Scheduler::Clock::now() - start;
+    portTest.elapsed = elapsed.count();
+}
+
+int findPort(RtMidi *midi, const std::string &name) {
+    for(unsigned int i = 0; i < midi->getPortCount(); ++i) {
+        if(midi->getPortName(i).find(name) != std::string::npos) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+RtMidiOut* openLoopback(RtMidiIn *midiin, const std::string &name) {
+    RtMidiOut *midiout = new RtMidiOut(midiin->getCurrentApi(), name);
+    midiout->setErrorCallback(midiError);
+    midiout->openVirtualPort(name);
+    int loopPort = findPort(midiin, name);
+    if(loopPort < 0) {
+        std::cout << "virtual port loopback not available" << std::endl;
+        delete midiout;
+        return nullptr;
+    }
+    midiin->openPort(loopPort);
+    std::cout << "opened " << midiin->getPortName(loopPort) << std::endl;
+    return midiout;
+}
+
+void midiBurstError(RtMidiError::Type type, const std::string &errorText, void *userData) {
+    if(type == RtMidiError::WARNING || type == RtMidiError::BUFFER_FULL) {
+        unsigned long *dropped = (unsigned long *)userData;
+        (*dropped)++;
+        return;
     }
+    midiError(type, errorText, userData);
 }
 
 void midiError(RtMidiError::Type type, const std::string &errorText, void *userData) {
@@ -0,0 +1,154 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// input allocation counting benchmark
+//
+// counts heap allocations while messages go through the input queue
+// alone & through the whole loopback input path once warmed up, which
+// should be none: channel & realtime messages are stored inline &
+// sysex reuses the overflow buffers of earlier messages
+//
+// usage: alloctest [message count]
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+#include "RtMidi.h"
+
+static std::atomic<unsigned long> allocations(0);
+
+// not inlined, otherwise gcc warns about free() on new'd pointers
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    allocations++;
+    void *p = std::malloc(size ? size : 1);
+    if(!p) {throw std::bad_alloc();}
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// largest sysex, warm up sends this size so later ones fit
+#define MAX_SYSEX_SIZE 512
+
+// mixed messages: mostly channel messages, some realtime & sysex,
+// or only max size sysex when warming up
+static void makeMessage(unsigned long index, bool maxSysex,
+                        std::vector<unsigned char> &message) {
+    if(maxSysex) {
+        message.assign(MAX_SYSEX_SIZE, 0x01);
+        message.front() = 0xF0;
+        message.back() = 0xF7;
+    }
+    else if(index % 100 == 99) {
+        message.assign(16 + index % (MAX_SYSEX_SIZE - 16), 0x01);
+        message.front() = 0xF0;
+        message.back() = 0xF7;
+    }
+    else if(index % 10 == 9) {
+        message.assign(1, 0xF8);
+    }
+    else {
+        message.assign({0x90, (unsigned char)(index & 0x7F), 0x64});
+    }
+}
+
+// push & pop through a queue on one thread, returns allocations
+static unsigned long queueRun(MidiInApi::MidiQueue &queue, unsigned long count,
+                              unsigned int batch, bool maxSysex) {
+    std::vector<unsigned char> message, received;
+    message.reserve(MAX_SYSEX_SIZE);
+    received.reserve(MAX_SYSEX_SIZE);
+    double timeStamp;
+    unsigned long before = allocations;
+    for(unsigned long index = 0; index < count; index += batch) {
+        for(unsigned int i = 0; i < batch; ++i) {
+            makeMessage(index + i, maxSysex, message);
+            queue.push(message, 0.0);
+        }
+        while(queue.pop(&received, &timeStamp)) {}
+    }
+    return allocations - before;
+}
+
+// send through a loopback port & poll the input queue, returns
+// allocations or -1 on error
+static long loopbackRun(RtMidiOut &midiout, RtMidiIn &midiin,
+                        unsigned long count, bool maxSysex) {
+    std::vector<unsigned char> message;
+    message.reserve(MAX_SYSEX_SIZE);
+    std::vector<std::vector<unsigned char>> received(64);
+    for(auto &bytes : received) {bytes.reserve(MAX_SYSEX_SIZE);}
+    std::vector<double> deltaTimes(received.size());
+    unsigned long before = allocations, got = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned long index = 0; index < count; ++index) {
+        makeMessage(index, maxSysex, message);
+        midiout.sendMessage(message.data(), message.size());
+        if(index % 32 == 31 || index + 1 == count) {
+            // wait for the input thread to catch up
+            while(got <= index) {
+                got += midiin.getMessages(&received[0], &deltaTimes[0], received.size());
+                if(std::chrono::steady_clock::now() - start > std::chrono::seconds(30)) {
+                    std::cout << "loopback stalled after " << got << " messages" << std::endl;
+                    return -1;
+                }
+            }
+        }
+    }
+    return allocations - before;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long count = (argc > 1 ? std::atol(argv[1]) : 1000000);
+    bool failed = false;
+
+    // queue alone, warm up every slot & overflow buffer with a max size
+    // sysex, then count with the mixed messages
+    MidiInApi::MidiQueue queue;
+    queue.allocate(256);
+    unsigned long warmup = queueRun(queue, 1024, 256, true);
+    unsigned long counted = queueRun(queue, count, 64, false);
+    std::cout << "queue: " << warmup << " allocations warming up, "
+              << counted << " for " << count << " messages" << std::endl;
+    failed = failed || counted > 0;
+
+    // whole loopback input path, the port queue, parser & input queue
+    // buffers all pass between each other so warm up with enough max
+    // size sysex to go around all of them a few times
+    RtMidiOut midiout(RtMidi::RTMIDI_LOOPBACK);
+    RtMidiIn midiin(RtMidi::RTMIDI_LOOPBACK);
+    midiin.ignoreTypes(false, false, false);
+    midiin.openPort(0);
+    midiout.openPort(0);
+    long loopbackWarmup = loopbackRun(midiout, midiin, 8192, true);
+    long loopbackCounted = loopbackRun(midiout, midiin, count, false);
+    std::cout << "loopback input: " << loopbackWarmup << " allocations warming up, "
+              << loopbackCounted << " for " << count << " messages" << std::endl;
+    failed = failed || loopbackWarmup < 0 || loopbackCounted != 0;
+
+    return (failed ? 1 : 0);
+}
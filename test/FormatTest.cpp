@@ -0,0 +1,158 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// console message formatter test & benchmark
+//
+// checks the byte table formatter prints the same text as the original
+// iostream printing for all four hex & name print modes, for every byte
+// value & a mix of messages, then times both on the mix
+//
+// usage: formattest [repeat count]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "Format.h"
+
+// the original printMessage() iostream printing, to an ostream
+static void streamMessage(std::ostream &out, const std::vector<unsigned char> &message,
+                          bool hex, bool name) {
+    if(message.size() < 1) {return;}
+    if(hex) {out << std::hex << std::uppercase;}
+    for(int byte : message) {
+        if(name && (byte & 0x80)) {
+            out << statusByteName(byte) << " ";
+        }
+        else {
+            out << byte << " ";
+        }
+    }
+    if(hex) {out << std::nouppercase << std::dec;}
+    out << std::endl;
+}
+
+// a mix of messages, mostly channel messages with some realtime & sysex
+static std::vector<std::vector<unsigned char>> makeMessages() {
+    std::vector<std::vector<unsigned char>> messages;
+    for(int i = 0; i < 1000; ++i) {
+        if(i % 100 == 99) {
+            std::vector<unsigned char> sysex(2 + i % 64, (unsigned char)(i & 0x7F));
+            sysex.front() = MIDI_SYSEX;
+            sysex.back() = MIDI_SYSEXEND;
+            messages.push_back(sysex);
+        }
+        else if(i % 10 == 9) {
+            messages.push_back({MIDI_CLOCK});
+        }
+        else if(i % 10 == 8) {
+            messages.push_back({(unsigned char)(MIDI_PROGRAMCHANGE | (i & 0x0F)),
+                                (unsigned char)(i & 0x7F)});
+        }
+        else {
+            messages.push_back({(unsigned char)(MIDI_NOTEON + (i % 7) * 0x10 + (i & 0x0F)),
+                                (unsigned char)(i & 0x7F), (unsigned char)((i * 3) & 0x7F)});
+        }
+    }
+    return messages;
+}
+
+// returns the number of messages which print differently
+static int compare(const std::vector<std::vector<unsigned char>> &messages,
+                   bool hex, bool name) {
+    const ByteTable &table = byteTable(hex, name);
+    int mismatches = 0;
+    for(const std::vector<unsigned char> &message : messages) {
+        std::ostringstream stream;
+        streamMessage(stream, message, hex, name);
+        std::string text;
+        formatMessage(table, message, text);
+        if(text != stream.str()) {
+            if(mismatches == 0) {
+                std::cout << "hex " << hex << " name " << name << ": \""
+                          << text << "\" != \"" << stream.str() << "\"" << std::endl;
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// messages per sec for the original iostream printing
+static double timeStream(const std::vector<std::vector<unsigned char>> &messages,
+                         bool hex, bool name, int repeat, size_t &bytes) {
+    std::ostringstream stream;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < repeat; ++i) {
+        stream.str("");
+        for(const std::vector<unsigned char> &message : messages) {
+            streamMessage(stream, message, hex, name);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    bytes = stream.str().size();
+    return messages.size() * repeat / elapsed.count();
+}
+
+// messages per sec for the byte table formatter
+static double timeTable(const std::vector<std::vector<unsigned char>> &messages,
+                        bool hex, bool name, int repeat, size_t &bytes) {
+    const ByteTable &table = byteTable(hex, name);
+    std::string buffer;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < repeat; ++i) {
+        buffer.clear();
+        for(const std::vector<unsigned char> &message : messages) {
+            formatMessage(table, message, buffer);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    bytes = buffer.size();
+    return messages.size() * repeat / elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+    int repeat = (argc > 1 ? std::atoi(argv[1]) : 200);
+
+    // every byte value on its own & the message mix
+    std::vector<std::vector<unsigned char>> bytes;
+    for(int byte = 0; byte < 256; ++byte) {
+        bytes.push_back({(unsigned char)byte});
+    }
+    std::vector<std::vector<unsigned char>> messages = makeMessages();
+
+    int mismatches = 0;
+    for(int mode = 0; mode < 4; ++mode) {
+        bool hex = (mode & 1), name = (mode & 2);
+        mismatches += compare(bytes, hex, name);
+        mismatches += compare(messages, hex, name);
+        size_t streamBytes, tableBytes;
+        double streamRate = timeStream(messages, hex, name, repeat, streamBytes);
+        double tableRate = timeTable(messages, hex, name, repeat, tableBytes);
+        std::cout << "hex " << hex << " name " << name << ": iostream "
+                  << streamRate << " messages per sec, table " << tableRate
+                  << " (" << tableRate / streamRate << "x)" << std::endl;
+        if(streamBytes != tableBytes) {
+            std::cout << "output sizes differ: " << streamBytes << " != " << tableBytes << std::endl;
+            mismatches++;
+        }
+    }
+    std::cout << mismatches << " mismatches" << std::endl;
+
+    return (mismatches > 0 ? 1 : 0);
+}
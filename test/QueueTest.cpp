@@ -0,0 +1,124 @@
+//
+// miditester: a utility program which sends MIDI bytes
+//
+// Copyright (C) 2017 Dan Wilcox <danomatika@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// MidiInApi::MidiQueue stress test
+//
+// a producer & a consumer thread pass millions of messages through a
+// small ring so it is full & empty over & over, the consumer checks that
+// every message arrives once, in order & intact, with its time stamps
+//
+// usage: queuetest [message count] [ring size]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "RtMidi.h"
+
+// every 1000th message is a sysex which is swapped into the overflow
+// buffer, the rest are 1-3 byte messages stored inline
+static unsigned int messageSize(unsigned long index) {
+    if(index % 1000 == 999) {return 20 + (index / 1000) % 300;}
+    return 1 + index % 3;
+}
+
+static unsigned char messageByte(unsigned long index, unsigned int i) {
+    return (unsigned char)(index * 7 + i);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long count = (argc > 1 ? std::atol(argv[1]) : 5000000);
+    unsigned int ringSize = (argc > 2 ? std::atoi(argv[2]) : 64);
+
+    MidiInApi::MidiQueue queue;
+    queue.allocate(ringSize);
+    std::cout << "queue stress test: " << count << " messages through "
+              << ringSize << " slots" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&queue, count]() {
+        MidiInApi::MidiMessage message;
+        for(unsigned long index = 0; index < count; ++index) {
+            unsigned int size = messageSize(index);
+            message.bytes.resize(size);
+            for(unsigned int i = 0; i < size; ++i) {
+                message.bytes[i] = messageByte(index, i);
+            }
+            message.timeStamp = index;
+            message.absoluteTime = index * 3;
+            if(size > MidiInApi::MidiSlot::INLINE_SIZE) {
+                while(!queue.pushSwap(message)) {std::this_thread::yield();}
+            }
+            else {
+                while(!queue.push(message)) {std::this_thread::yield();}
+            }
+        }
+    });
+
+    // consume & check
+    unsigned long errors = 0;
+    std::vector<unsigned char> bytes;
+    double timeStamp;
+    unsigned long long absoluteTime;
+    unsigned long index = 0;
+    for(; index < count; ++index) {
+        // lost messages would otherwise leave us waiting forever
+        auto wait = std::chrono::steady_clock::now();
+        bool stalled = false;
+        while(!queue.pop(&bytes, &timeStamp, &absoluteTime)) {
+            std::this_thread::yield();
+            if(std::chrono::steady_clock::now() - wait > std::chrono::seconds(5)) {
+                stalled = true;
+                break;
+            }
+        }
+        if(stalled) {
+            std::cout << "stalled after " << index << " messages" << std::endl;
+            errors++;
+            break;
+        }
+        bool ok = (bytes.size() == messageSize(index) &&
+                   timeStamp == index && absoluteTime == index * 3);
+        for(unsigned int i = 0; ok && i < bytes.size(); ++i) {
+            ok = (bytes[i] == messageByte(index, i));
+        }
+        if(!ok) {
+            if(errors < 10) {
+                std::cout << "message " << index << " is corrupt or out of order"
+                          << std::endl;
+            }
+            errors++;
+        }
+    }
+    if(index < count) {
+        // the producer may still be waiting to push, exit without it
+        producer.detach();
+        std::cout << errors << " errors" << std::endl;
+        return 1;
+    }
+    producer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if(queue.size() != 0 || queue.pop(&bytes, &timeStamp)) {
+        std::cout << "queue is not empty at the end" << std::endl;
+        errors++;
+    }
+    std::cout << (count / elapsed.count()) << " messages per sec, "
+              << errors << " errors" << std::endl;
+    return (errors == 0 ? 0 : 1);
+}